@@ -0,0 +1,158 @@
+/**
+ * how the device table scales with the number of devices.
+ * the xinput requests are answered by stubs, so only the table itself is measured.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string>
+
+#include <X11/Xatom.h>
+#include <X11/extensions/XI2.h>
+
+#include "devices.h"
+
+using namespace xautocfg;
+
+
+// the simulated server: devices 2 and 3 are the core master pointer and keyboard,
+// all others are slave keyboards attached to 3.
+static int device_count = 0;
+static size_t queries = 0;
+
+static void fill_info(XIDeviceInfo *info, int deviceid) {
+	info->deviceid = deviceid;
+	info->name = strdup(std::format("keyboard {}", deviceid).c_str());
+	info->use = deviceid == 2 ? XIMasterPointer : deviceid == 3 ? XIMasterKeyboard : XISlaveKeyboard;
+	info->attachment = deviceid == 2 ? 3 : deviceid == 3 ? 2 : 3;
+	info->enabled = True;
+	info->num_classes = 0;
+	info->classes = nullptr;
+}
+
+extern "C" {
+
+// the arrays end with an entry without name.
+// like the server, there's an error for devices that are gone and libXi returns null.
+XIDeviceInfo *XIQueryDevice(Display *, int deviceid, int *count) {
+	queries++;
+	if (deviceid != XIAllDevices and (deviceid < 2 or deviceid >= device_count + 2)) {
+		*count = 0;
+		return nullptr;
+	}
+	*count = deviceid == XIAllDevices ? device_count : 1;
+	auto *info = static_cast<XIDeviceInfo *>(calloc(*count + 1, sizeof(XIDeviceInfo)));
+	for (int i = 0; i < *count; i++) {
+		fill_info(&info[i], deviceid == XIAllDevices ? i + 2 : deviceid);
+	}
+	return info;
+}
+
+// like libXi, null isn't checked
+void XIFreeDeviceInfo(XIDeviceInfo *info) {
+	for (XIDeviceInfo *dev = info; dev->name; dev++) {
+		free(dev->name);
+	}
+	free(info);
+}
+
+Status XIGetProperty(Display *, int deviceid, Atom, long, long, Bool, Atom,
+                     Atom *type, int *format, unsigned long *count,
+                     unsigned long *remaining, unsigned char **data) {
+	queries++;
+	auto *ids = static_cast<uint32_t *>(malloc(2 * sizeof(uint32_t)));
+	ids[0] = 0x046d;
+	ids[1] = deviceid;
+	*type = XA_INTEGER;
+	*format = 32;
+	*count = 2;
+	*remaining = 0;
+	*data = reinterpret_cast<unsigned char *>(ids);
+	return Success;
+}
+
+Atom XInternAtom(Display *, const char *, Bool) {
+	return XA_LAST_PREDEFINED + 1;
+}
+
+} // extern "C"
+
+
+/**
+ * nanoseconds per call of func, which does count operations.
+ */
+template <typename F>
+double measure(size_t count, F &&func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+}
+
+
+void run(int devices) {
+	device_count = devices;
+	queries = 0;
+	device_table table{nullptr};
+
+	double load = measure(devices, [&] { table.load(); });
+
+	// the scan every reload and resume does
+	constexpr int scans = 100;
+	size_t found = 0;
+	double scan = measure(size_t{scans} * devices, [&] {
+		for (int i = 0; i < scans; i++) {
+			table.for_each(XISlaveKeyboard, [&](int) { found++; });
+		}
+	});
+
+	// what a plug event does: lookup, product id on first use, then cached
+	double first_lookup = measure(devices, [&] {
+		for (int id = 2; id < devices + 2; id++) {
+			table.product_id(id);
+		}
+	});
+	double cached_lookup = measure(devices, [&] {
+		for (int id = 2; id < devices + 2; id++) {
+			table.product_id(id);
+		}
+	});
+
+	// every keyboard unplugged and plugged again, the id is reused
+	double replug = measure(devices, [&] {
+		for (int id = 4; id < devices + 2; id++) {
+			table.update({id, 3, XISlaveKeyboard, True, XISlaveRemoved});
+			table.update({id, 3, XISlaveKeyboard, True, XISlaveAdded});
+		}
+	});
+
+	// hierarchy events of devices that were gone before they were processed
+	for (int id = devices + 2; id < devices + 12; id++) {
+		table.update({id, 3, XISlaveKeyboard, True, XISlaveAdded});
+	}
+
+	std::cout << std::format("{:>6} devices: load {:7.1f} ns, scan {:5.2f} ns, "
+	                         "first product id {:7.1f} ns, cached {:5.2f} ns, replug {:7.1f} ns "
+	                         "per device, {} requests\n",
+	                         devices, load, scan, first_lookup, cached_lookup, replug, queries);
+	if (found != size_t{scans} * (devices - 2)) {
+		std::cerr << "scan found " << found << " keyboards" << std::endl;
+		std::exit(1);
+	}
+}
+
+
+int main() {
+	for (int devices : {10, 100, 1000, 10000}) {
+		run(devices);
+	}
+	return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * time of the gamma ramp paths for common ramp sizes.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "gamma.h"
+
+using namespace xautocfg;
+
+
+// keeps the compiler from dropping the ramps
+volatile uint16_t sink;
+
+/**
+ * nanoseconds per ramp.
+ */
+template <typename F>
+double measure(size_t size, F &&fill) {
+	std::vector<uint16_t> ramp(size);
+	size_t rounds = std::max<size_t>(1, (1 << 24) / size);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < rounds; r++) {
+		// a different top each round, like the fade steps of color
+		fill(ramp.data(), size, 0.5f + (r % 64) / 128.f);
+		sink = ramp[size - 1];
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+
+template <auto Path>
+void fill_path(uint16_t *ramp, size_t size, float top) {
+	float step = gamma_ramp::step(size, top);
+	size_t done = Path(ramp, 0, size, step);
+	gamma_ramp::fill_scalar(ramp, done, size, step);
+}
+
+
+int main() {
+	for (size_t size : {256, 1024, 4096}) {
+		std::cout << std::format("{:>5} entries: fill_ramp {:7.1f} ns, scalar {:7.1f} ns",
+		                         size, measure(size, fill_ramp),
+		                         measure(size, fill_path<gamma_ramp::fill_scalar>));
+#if defined(__SSE2__)
+		std::cout << std::format(", sse2 {:7.1f} ns", measure(size, fill_path<gamma_ramp::fill_sse2>));
+#endif
+#if defined(__AVX2__)
+		std::cout << std::format(", avx2 {:7.1f} ns", measure(size, fill_path<gamma_ramp::fill_avx2>));
+#endif
+		std::cout << " per ramp\n";
+	}
+	return 0;
+}
@@ -0,0 +1,264 @@
+/**
+ * color temperature and brightness of the monitors, by time of day.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "color.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/randr.h>
+
+#include "dpi.h"
+#include "gamma.h"
+#include "log.h"
+
+
+namespace xautocfg {
+
+color_manager::color_manager(Display *display, timer_wheel *timers, bool watch,
+                             const struct config::color &cfg)
+	:
+	display{display},
+	root{DefaultRootWindow(display)},
+	timers{timers},
+	watch{watch},
+	cfg{cfg} {
+
+	// crtc gamma is 1.2, the current screen resources are 1.3
+	int error_base, major = 1, minor = 3;
+	if (not XRRQueryExtension(this->display, &this->event_base, &error_base)
+	    or not XRRQueryVersion(this->display, &major, &minor)
+	    or major < 1 or (major == 1 and minor < 3)) {
+		log_error() << "randr 1.3 is not available, can't set colors";
+		return;
+	}
+	this->have_randr = true;
+
+	if (watch) {
+		XRRSelectInput(this->display, this->root, randr_event_mask);
+	}
+	this->update();
+}
+
+
+color_manager::~color_manager() {
+	this->timers->cancel(this->timer);
+}
+
+
+void color_manager::configure(const struct config::color &cfg) {
+	this->cfg = cfg;
+	for (auto &crtc : this->crtcs) {
+		crtc.temperature = 0;
+	}
+	if (this->have_randr) {
+		this->timers->cancel(this->timer);
+		this->update();
+	}
+}
+
+
+bool color_manager::handle_event(XEvent &event) {
+	if (not this->have_randr) {
+		return false;
+	}
+
+	if (event.type == this->event_base + RRNotify) {
+		int subtype = reinterpret_cast<XRRNotifyEvent &>(event).subtype;
+		if (subtype != RRNotify_CrtcChange and subtype != RRNotify_OutputChange) {
+			return true;
+		}
+	}
+	else if (event.type != this->event_base + RRScreenChangeNotify) {
+		return false;
+	}
+
+	// the rest of the burst is handled by the same update
+	if (not this->crtcs_stale) {
+		this->crtcs_stale = true;
+		this->timers->cancel(this->timer);
+		this->timer = this->timers->add(settle_delay, [this] {
+			this->update();
+		});
+	}
+	return true;
+}
+
+
+void color_manager::restore() {
+	for (auto &[id, ramps] : this->originals) {
+		size_t size = ramps.size() / 3;
+		XRRCrtcGamma *gamma = XRRAllocGamma(size);
+		if (not gamma) {
+			continue;
+		}
+		std::copy_n(ramps.data(), size, gamma->red);
+		std::copy_n(ramps.data() + size, size, gamma->green);
+		std::copy_n(ramps.data() + 2 * size, size, gamma->blue);
+		XRRSetCrtcGamma(this->display, id, gamma);
+		XRRFreeGamma(gamma);
+	}
+	this->originals.clear();
+	for (auto &crtc : this->crtcs) {
+		crtc.temperature = 0;
+		crtc.sent.clear();
+	}
+}
+
+
+void color_manager::update() {
+	auto now = std::chrono::system_clock::now();
+	std::time_t now_t = std::chrono::system_clock::to_time_t(now);
+	std::tm local;
+	localtime_r(&now_t, &local);
+	auto subsec = now - std::chrono::system_clock::from_time_t(now_t);
+	double minutes = local.tm_hour * 60 + local.tm_min
+	                 + (local.tm_sec + std::chrono::duration<double>(subsec).count()) / 60;
+
+	auto [night, until_change] = this->night_at(minutes);
+
+	if (this->crtcs_stale) {
+		this->load_crtcs();
+	}
+	for (auto &crtc : this->crtcs) {
+		auto &settings = this->cfg.settings_for(crtc.output);
+		double temperature = settings.temperature
+		                     + (settings.night_temperature - settings.temperature) * night;
+		double brightness = settings.brightness
+		                    + (settings.night_brightness - settings.brightness) * night;
+		// steps below this aren't visible, they don't need new ramps
+		this->set_ramps(&crtc, std::lround(temperature / 10) * 10, std::lround(brightness * 10));
+	}
+
+	if (not this->watch) {
+		return;
+	}
+	// the monotonic clock stops during suspend and the wall clock can jump,
+	// so don't sleep until the next fade in one go
+	auto delay = std::min(std::chrono::milliseconds{static_cast<int64_t>(until_change * 60000)},
+	                      std::chrono::milliseconds{std::chrono::minutes{5}});
+	this->timer = this->timers->add(std::max(delay, fade_tick), [this] {
+		this->update();
+	});
+}
+
+
+std::pair<double, double> color_manager::night_at(double minutes) const {
+	constexpr double day = 24 * 60;
+	auto since = [&](int start) {
+		return std::fmod(minutes - start + day, day);
+	};
+	double since_dusk = since(this->cfg.dusk);
+	double since_dawn = since(this->cfg.dawn);
+	// whichever was last
+	bool is_night = since_dusk < since_dawn;
+	double since_start = is_night ? since_dusk : since_dawn;
+
+	if (since_start < this->cfg.fade) {
+		double progress = since_start / this->cfg.fade;
+		return {is_night ? progress : 1 - progress, 0};
+	}
+	return {is_night ? 1 : 0, day - std::max(since_dusk, since_dawn)};
+}
+
+
+void color_manager::load_crtcs() {
+	this->crtcs_stale = false;
+
+	XRRScreenResources *res = XRRGetScreenResourcesCurrent(this->display, this->root);
+	if (not res) {
+		this->crtcs.clear();
+		return;
+	}
+
+	std::vector<crtc> next;
+	for (int i = 0; i < res->noutput; i++) {
+		XRROutputInfo *info = XRRGetOutputInfo(this->display, res, res->outputs[i]);
+		if (not info) {
+			continue;
+		}
+		RRCrtc id = info->crtc;
+		std::string name{info->name, static_cast<size_t>(info->nameLen)};
+		XRRFreeOutputInfo(info);
+
+		// clones share the crtc, the first output's settings win
+		if (id == None or std::ranges::find(next, id, &crtc::id) != next.end()) {
+			continue;
+		}
+
+		int size = XRRGetCrtcGammaSize(this->display, id);
+		if (size <= 1) {
+			continue;
+		}
+
+		// what it already has doesn't need to be sent again
+		auto old = std::ranges::find(this->crtcs, id, &crtc::id);
+		if (old != this->crtcs.end() and old->size == size and old->output == name) {
+			next.push_back(std::move(*old));
+		}
+		else {
+			next.push_back({id, std::move(name), size, 0, 0, {}});
+		}
+
+		auto original = this->originals.find(id);
+		if (original != this->originals.end() and original->second.size() != size * 3u) {
+			this->originals.erase(original);
+		}
+	}
+	XRRFreeScreenResources(res);
+
+	this->crtcs = std::move(next);
+}
+
+
+void color_manager::set_ramps(crtc *crtc, int temperature, int brightness) {
+	if (temperature == crtc->temperature and brightness == crtc->brightness) {
+		return;
+	}
+	crtc->temperature = temperature;
+	crtc->brightness = brightness;
+
+	size_t size = crtc->size;
+	auto white = whitepoint(temperature);
+	this->scratch.resize(size * 3);
+	for (size_t c = 0; c < 3; c++) {
+		fill_ramp(this->scratch.data() + c * size, size, white[c] * brightness / 1000.f);
+	}
+	if (this->scratch == crtc->sent) {
+		return;
+	}
+
+	if (this->watch and not this->originals.contains(crtc->id)) {
+		if (XRRCrtcGamma *current = XRRGetCrtcGamma(this->display, crtc->id)) {
+			if (current->size == crtc->size) {
+				auto &original = this->originals[crtc->id];
+				original.insert(original.end(), current->red, current->red + size);
+				original.insert(original.end(), current->green, current->green + size);
+				original.insert(original.end(), current->blue, current->blue + size);
+			}
+			XRRFreeGamma(current);
+		}
+	}
+
+	XRRCrtcGamma *gamma = XRRAllocGamma(size);
+	if (not gamma) {
+		return;
+	}
+	std::copy_n(this->scratch.data(), size, gamma->red);
+	std::copy_n(this->scratch.data() + size, size, gamma->green);
+	std::copy_n(this->scratch.data() + 2 * size, size, gamma->blue);
+	XRRSetCrtcGamma(this->display, crtc->id, gamma);
+	XRRFreeGamma(gamma);
+
+	std::swap(this->scratch, crtc->sent);
+}
+
+} // namespace xautocfg
@@ -0,0 +1,114 @@
+/**
+ * color temperature and brightness of the monitors, by time of day.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "config.h"
+#include "timers.h"
+
+
+namespace xautocfg {
+
+/**
+ * sets the gamma ramps of all active crtcs for the color temperature
+ * and brightness of their output at the current time of day.
+ *
+ * during a fade it updates several times a second, otherwise it sleeps
+ * until the next fade starts. ramps are only generated when the rounded
+ * temperature or brightness changed, and only sent when their content changed.
+ */
+class color_manager {
+public:
+	/**
+	 * sets the ramps for now. with watch, they follow the time and the
+	 * monitors, and restore() puts back the ramps from before.
+	 */
+	color_manager(Display *display, timer_wheel *timers, bool watch, const struct config::color &cfg);
+	~color_manager();
+
+	color_manager(const color_manager &) = delete;
+	color_manager &operator =(const color_manager &) = delete;
+
+	/**
+	 * use other settings, the ramps are updated right away.
+	 */
+	void configure(const struct config::color &cfg);
+
+	/**
+	 * process an event, false if it isn't from randr.
+	 */
+	bool handle_event(XEvent &event);
+
+	/**
+	 * set the ramps the crtcs had before we changed them.
+	 * not flushed.
+	 */
+	void restore();
+
+private:
+	static constexpr std::chrono::milliseconds fade_tick{200};
+	static constexpr std::chrono::milliseconds settle_delay{250};
+
+	struct crtc {
+		RRCrtc id;
+		std::string output;
+		int size;
+
+		// what was generated last, to skip the same values
+		int temperature = 0;
+		int brightness = 0;
+		// red, green and blue ramps as last sent
+		std::vector<uint16_t> sent;
+	};
+
+	/**
+	 * set the ramps for now and schedule the next update.
+	 */
+	void update();
+
+	/**
+	 * how far into the night a local time in minutes after midnight is,
+	 * 0 by day and 1 by night, and the minutes until it may change.
+	 */
+	std::pair<double, double> night_at(double minutes) const;
+
+	/**
+	 * the active crtcs and their outputs.
+	 */
+	void load_crtcs();
+
+	void set_ramps(crtc *crtc, int temperature, int brightness);
+
+	Display *display;
+	Window root;
+	timer_wheel *timers;
+	bool watch;
+	struct config::color cfg;
+
+	bool have_randr = false;
+	int event_base = 0;
+	timer_wheel::handle timer;
+
+	std::vector<crtc> crtcs;
+	bool crtcs_stale = true;
+	// the ramps from before we set them, red, green and blue
+	std::unordered_map<RRCrtc, std::vector<uint16_t>> originals;
+	std::vector<uint16_t> scratch;
+};
+
+} // namespace xautocfg
@@ -0,0 +1,613 @@
+/**
+ * the xautocfg configuration and its parser.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "keyboard_settings.h"
+#include "log.h"
+#include "parse.h"
+#include "util.h"
+
+using namespace std::literals;
+
+
+namespace xautocfg {
+
+enum class config_section {
+	none,
+	keyboard,
+	keyboard_rule,
+	app_profile,
+	resources,
+	session,
+	quirks,
+	hooks,
+	color,
+	color_output,
+};
+
+
+void hook_set::check() const {
+	for (auto &hook : this->hooks) {
+		for (auto &name : hook.after) {
+			if (std::ranges::find(this->hooks, name, &hook_command::name) == this->hooks.end()) {
+				throw std::logic_error{std::format("hook '{}' comes after unknown hook '{}'",
+				                                   hook.name, name)};
+			}
+		}
+	}
+
+	// drop hooks that only come after dropped ones, what remains waits in a cycle
+	std::vector<const hook_command *> left;
+	for (auto &hook : this->hooks) {
+		left.push_back(&hook);
+	}
+	while (true) {
+		std::vector<const hook_command *> waiting;
+		for (auto *hook : left) {
+			if (std::ranges::any_of(hook->after, [&](auto &name) {
+				return std::ranges::find(left, name, &hook_command::name) != left.end();
+			})) {
+				waiting.push_back(hook);
+			}
+		}
+		if (waiting.size() == left.size()) {
+			break;
+		}
+		left = std::move(waiting);
+	}
+
+	if (not left.empty()) {
+		std::string names;
+		for (auto *hook : left) {
+			names += (names.empty() ? "" : ", ") + hook->name;
+		}
+		throw std::logic_error{std::format("hooks come after each other: {}", names)};
+	}
+}
+
+
+void parse_keyboard_entry(struct config::keyboard *keyboard,
+                          const std::string& key,
+                          const std::string& val) {
+	if (not keyboard_settings::parse(keyboard, key, val)
+	    and not keyboard_setting::named_hook::parse(keyboard, key, val)) {
+		throw std::logic_error{std::format("unknown keyboard section entry: {}", key)};
+	}
+}
+
+
+void parse_session_entry(session_settings *session,
+                         const std::string& key,
+                         const std::string& val) {
+	if (key == "bell"sv) {
+		// on: server default volume
+		if (val == "off"sv) {
+			session->bell_percent = 0;
+		}
+		else if (val == "on"sv) {
+			session->bell_percent = -1;
+		}
+		else {
+			session->bell_percent = parse_int(val);
+		}
+	}
+	else if (key == "bell_pitch"sv) {
+		session->bell_pitch = parse_int(val);
+	}
+	else if (key == "bell_duration"sv) {
+		session->bell_duration = parse_int(val);
+	}
+	else if (key == "screensaver"sv or key == "screensaver_cycle"sv) {
+		// the protocol has 16 bit signed fields, -1 is the server default
+		int seconds = (key == "screensaver"sv and val == "off"sv) ? 0 : parse_int(val);
+		if (seconds < 0 or seconds > INT16_MAX) {
+			throw std::logic_error{std::format("{} needs to be 0 to 32767 seconds, got: {}", key, val)};
+		}
+		(key == "screensaver"sv ? session->screensaver_timeout : session->screensaver_cycle) = seconds;
+	}
+	else if (key == "dpms"sv) {
+		if (val == "off"sv) {
+			session->dpms = std::optional<std::array<uint16_t, 3>>{};
+		}
+		else {
+			auto invalid = [&] {
+				return std::logic_error{std::format("dpms needs 'off' or 'standby suspend off' "
+				                                    "of 0 to 65535 seconds, got: {}", val)};
+			};
+			std::istringstream vals{val};
+			std::array<uint16_t, 3> timeouts;
+			for (auto &timeout : timeouts) {
+				std::string word;
+				if (not (vals >> word)) {
+					throw invalid();
+				}
+				int seconds;
+				try {
+					seconds = parse_int(word);
+				}
+				catch (std::logic_error &) {
+					throw invalid();
+				}
+				if (seconds < 0 or seconds > UINT16_MAX) {
+					throw invalid();
+				}
+				timeout = seconds;
+			}
+			if (std::string rest; vals >> rest) {
+				throw invalid();
+			}
+			session->dpms = timeouts;
+		}
+	}
+	else if (key == "pointer_accel"sv) {
+		// 'num/denom' or 'num', like xset m
+		size_t slash = val.find('/');
+		int num, denom = 1;
+		try {
+			num = parse_int(val.substr(0, slash));
+			if (slash != std::string::npos) {
+				denom = parse_int(val.substr(slash + 1));
+			}
+		}
+		catch (std::logic_error &) {
+			throw std::logic_error{std::format("pointer_accel needs 'num/denom' or 'num', got: {}", val)};
+		}
+		if (num < 0 or denom <= 0) {
+			throw std::logic_error{std::format("invalid pointer_accel: {}", val)};
+		}
+		session->pointer_accel = std::pair{num, denom};
+	}
+	else if (key == "pointer_threshold"sv) {
+		session->pointer_threshold = parse_int(val);
+	}
+	else {
+		throw std::logic_error{std::format("unknown session section entry: {}", key)};
+	}
+}
+
+
+void parse_color_entry(color_settings *color,
+                       const std::string& key,
+                       const std::string& val) {
+	auto temperature = [&] {
+		int kelvin = parse_int(val);
+		if (kelvin < 1000 or kelvin > 25000) {
+			throw std::logic_error{std::format("{} needs to be 1000 to 25000 kelvin, got: {}", key, val)};
+		}
+		return kelvin;
+	};
+	auto brightness = [&] {
+		int percent = parse_int(val);
+		if (percent < 10 or percent > 100) {
+			throw std::logic_error{std::format("{} needs to be 10 to 100 percent, got: {}", key, val)};
+		}
+		return percent;
+	};
+
+	if (key == "temperature"sv) {
+		color->temperature = temperature();
+	}
+	else if (key == "night_temperature"sv) {
+		color->night_temperature = temperature();
+	}
+	else if (key == "brightness"sv) {
+		color->brightness = brightness();
+	}
+	else if (key == "night_brightness"sv) {
+		color->night_brightness = brightness();
+	}
+	else {
+		throw std::logic_error{std::format("unknown color section entry: {}", key)};
+	}
+}
+
+
+void parse_config_entry(config *config,
+                        config_section section,
+                        size_t index,
+                        const std::string& key,
+                        const std::string& val) {
+	switch (section) {
+	case config_section::keyboard:
+		parse_keyboard_entry(&config->keyboard, key, val);
+		break;
+	case config_section::keyboard_rule: {
+		auto &rule = config->device_rules[index];
+		if (key == "match"sv) {
+			rule.match_src = val;
+			rule.match = std::regex{val, std::regex::optimize};
+		}
+		else if (key == "master"sv) {
+			rule.master_src = val;
+			rule.master = std::regex{val, std::regex::optimize};
+		}
+		else {
+			// checked now, so errors have the line number
+			struct config::keyboard check;
+			parse_keyboard_entry(&check, key, val);
+			rule.entries.emplace_back(key, val);
+		}
+		break;
+	}
+	case config_section::app_profile: {
+		auto &profile = config->app_profiles[index];
+		if (key == "match"sv) {
+			profile.match_src = val;
+			profile.match = std::regex{val, std::regex::optimize};
+		}
+		else if (key == "delay"sv or key == "rate"sv) {
+			struct config::keyboard check;
+			parse_keyboard_entry(&check, key, val);
+			profile.entries.emplace_back(key, val);
+		}
+		else {
+			throw std::logic_error{std::format("unknown application section entry: {}", key)};
+		}
+		break;
+	}
+	case config_section::resources:
+		if (key == "file"sv) {
+			config->resources.files.push_back(expand_home(val));
+		}
+		else if (key == "cpp"sv) {
+			config->resources.cpp = (val == "off"sv) ? "" : val;
+		}
+		else if (key == "dpi"sv) {
+			if (val != "auto"sv and val != "off"sv) {
+				throw std::logic_error{std::format("expected auto or off, got: {}", val)};
+			}
+			config->resources.dpi = (val == "auto"sv);
+		}
+		else if (key == "cursor_size"sv) {
+			config->resources.cursor_size = (val == "off"sv) ? 0 : parse_int(val);
+			if (config->resources.cursor_size < 0) {
+				throw std::logic_error{std::format("expected off or a size, got: {}", val)};
+			}
+		}
+		else {
+			throw std::logic_error{std::format("unknown resources section entry: {}", key)};
+		}
+		break;
+	case config_section::session:
+		parse_session_entry(&config->session, key, val);
+		break;
+	case config_section::quirks:
+		if (key == "file"sv) {
+			config->quirks_db = expand_home(val);
+		}
+		else {
+			throw std::logic_error{std::format("unknown quirks section entry: {}", key)};
+		}
+		break;
+	case config_section::hooks:
+		if (key == "jobs"sv or key == "queue"sv) {
+			int limit = parse_int(val);
+			if (limit < 1) {
+				throw std::logic_error{std::format("{} needs to be at least 1, got: {}", key, val)};
+			}
+			(key == "jobs"sv ? config->hooks.jobs : config->hooks.queue) = limit;
+		}
+		else if (key == "shed"sv) {
+			if (val == "oldest"sv) {
+				config->hooks.shed = shed_policy::oldest;
+			}
+			else if (val == "newest"sv) {
+				config->hooks.shed = shed_policy::newest;
+			}
+			else {
+				throw std::logic_error{std::format("expected oldest or newest, got: {}", val)};
+			}
+		}
+		else {
+			throw std::logic_error{std::format("unknown hooks section entry: {}", key)};
+		}
+		break;
+	case config_section::color:
+		config->color.enabled = true;
+		if (key == "dusk"sv) {
+			config->color.dusk = parse_clock(val);
+		}
+		else if (key == "dawn"sv) {
+			config->color.dawn = parse_clock(val);
+		}
+		else if (key == "fade"sv) {
+			config->color.fade = parse_int(val);
+			if (config->color.fade < 0 or config->color.fade > 12 * 60) {
+				throw std::logic_error{std::format("fade needs to be 0 to 720 minutes, got: {}", val)};
+			}
+		}
+		else {
+			parse_color_entry(&config->color.settings, key, val);
+		}
+		break;
+	case config_section::color_output: {
+		config->color.enabled = true;
+		// checked now, so errors have the line number
+		color_settings check;
+		parse_color_entry(&check, key, val);
+		config->color.outputs[index].entries.emplace_back(key, val);
+		break;
+	}
+	case config_section::none:
+		throw std::logic_error{std::format("not in a config section: {} = {}", key, val)};
+	}
+}
+
+
+/**
+ * index of the section with this name, added if there's none yet.
+ * a later file or part of the file can so add to an earlier section.
+ */
+template <typename T>
+size_t named_section(std::vector<T> *sections, std::string_view name) {
+	auto it = std::ranges::find(*sections, name, &T::name);
+	if (it != sections->end()) {
+		return it - sections->begin();
+	}
+	sections->push_back({});
+	sections->back().name = name;
+	return sections->size() - 1;
+}
+
+
+/**
+ * list entries add to their list within a file,
+ * but a later file replaces the list the earlier ones built.
+ * clear that list if key is one, before its first entry in a file.
+ */
+void start_list(config *config, config_section section, size_t index, const std::string &key) {
+	if (section == config_section::keyboard and key == "remap"sv) {
+		config->keyboard.remaps.clear();
+	}
+	else if (section == config_section::keyboard_rule and key == "remap"sv) {
+		std::erase_if(config->device_rules[index].entries, [](auto &entry) {
+			return entry.first == "remap"sv;
+		});
+	}
+	else if (section == config_section::resources and key == "file"sv) {
+		config->resources.files.clear();
+	}
+}
+
+
+/**
+ * add the sections and entries of one file to the config.
+ */
+void parse_config_file(std::istream &file, config *cfg) {
+	config &ret = *cfg;
+
+	const std::regex comment_re("^ *([^#]*) *#?.*");
+	const std::regex section_re("^\\[([^\\]]+)\\]$");
+	const std::regex kv_re("^([^= ]+) *= *(.+)$");
+	config_section current_section = config_section::none;
+	size_t current_index = 0;
+	std::string current_name;
+	// section and key of the lists this file has added to
+	std::set<std::pair<std::string, std::string>> lists;
+
+	std::string fullline{};
+	int linenr = 0;
+	while (std::getline(file, fullline)) {
+		linenr += 1;
+		// filter comments
+		std::smatch comment_match;
+		std::regex_match(fullline, comment_match, comment_re);
+		if (not comment_match.ready() or comment_match.size() != 2) {
+			throw std::runtime_error{std::format("error in config file line {}:\n{}",
+			                                     linenr, fullline)};
+		}
+
+		const std::string& line{comment_match[1]};
+
+		// filter empty lines
+		if (line.size() == 0 or std::ranges::all_of(line, [](const char c) {
+			return c == ' ';
+		})) {
+			continue;
+		}
+
+		// parse '[section]'
+		{
+			std::smatch match;
+			std::regex_match(line, match, section_re);
+			if (match.ready() and match.size() == 2) {
+				const std::string& section_name{match[1]};
+				current_name = section_name;
+				if (section_name == "keyboard") {
+					current_section = config_section::keyboard;
+				}
+				else if (section_name == "session") {
+					current_section = config_section::session;
+				}
+				else if (section_name == "resources") {
+					current_section = config_section::resources;
+				}
+				else if (section_name == "quirks") {
+					current_section = config_section::quirks;
+				}
+				else if (section_name == "hooks") {
+					current_section = config_section::hooks;
+				}
+				else if (section_name == "color") {
+					current_section = config_section::color;
+				}
+				else if (section_name.starts_with("color.")) {
+					current_section = config_section::color_output;
+					current_index = named_section(&ret.color.outputs, section_name.substr("color."sv.size()));
+				}
+				else if (section_name.starts_with("application.")) {
+					current_section = config_section::app_profile;
+					current_index = named_section(&ret.app_profiles, section_name.substr("application."sv.size()));
+				}
+				else if (section_name.starts_with("keyboard.")) {
+					current_section = config_section::keyboard_rule;
+					current_index = named_section(&ret.device_rules, section_name.substr("keyboard."sv.size()));
+				}
+				else {
+					throw std::runtime_error{std::format("unknown section name: {}", fullline)};
+				}
+				continue;
+			}
+		}
+
+		// parse 'key = value'
+		{
+			std::smatch match;
+			std::regex_match(line, match, kv_re);
+			if (match.ready() and match.size() == 3) {
+				const std::string& key{match[1]};
+				const std::string& val{match[2]};
+
+				try {
+					if (lists.emplace(current_name, key).second) {
+						start_list(&ret, current_section, current_index, key);
+					}
+					parse_config_entry(&ret, current_section, current_index, key, val);
+				}
+				catch (std::logic_error &err) {
+					throw std::runtime_error{std::format("error in config file line {}: {}",
+					                                     linenr, err.what())};
+				}
+				continue;
+			}
+		}
+
+		throw std::runtime_error{std::format("invalid syntax in line {}:\n{}", linenr, fullline)};
+	}
+}
+
+
+/**
+ * what depends on the whole config, once all files are read.
+ */
+void finish_config(config *cfg) {
+	config &ret = *cfg;
+
+	// device rules inherit [keyboard], no matter where it was in the file
+	for (auto &rule : ret.device_rules) {
+		if (not rule.match and not rule.master) {
+			throw std::runtime_error{std::format("device rule [keyboard.{}] needs a 'match' or 'master' entry",
+			                                     rule.name)};
+		}
+		rule.keyboard = ret.keyboard;
+		rule.keyboard.rule = "keyboard." + rule.name;
+		rule.keyboard.remaps.clear();
+		for (auto &[key, val] : rule.entries) {
+			parse_keyboard_entry(&rule.keyboard, key, val);
+		}
+		if (rule.keyboard.remaps.empty()) {
+			rule.keyboard.remaps = ret.keyboard.remaps;
+		}
+		rule.entries.clear();
+	}
+
+	// outputs inherit [color] the same way
+	for (auto &output : ret.color.outputs) {
+		output.settings = ret.color.settings;
+		for (auto &[key, val] : output.entries) {
+			parse_color_entry(&output.settings, key, val);
+		}
+		output.entries.clear();
+	}
+
+	// after the rules, they may add hooks that others come after
+	auto check_hooks = [](const struct config::keyboard &kbd) {
+		try {
+			kbd.on_connect.check();
+			kbd.on_disconnect.check();
+		}
+		catch (std::logic_error &err) {
+			throw std::runtime_error{std::format("error in [{}]: {}", kbd.rule, err.what())};
+		}
+	};
+	check_hooks(ret.keyboard);
+	for (auto &rule : ret.device_rules) {
+		check_hooks(rule.keyboard);
+	}
+
+	for (auto &profile : ret.app_profiles) {
+		if (profile.match_src.empty()) {
+			throw std::runtime_error{std::format("application profile [application.{}] needs a 'match' entry",
+			                                     profile.name)};
+		}
+		struct config::keyboard kbd = ret.keyboard;
+		for (auto &[key, val] : profile.entries) {
+			parse_keyboard_entry(&kbd, key, val);
+		}
+		profile.delay = kbd.delay;
+		profile.interval = kbd.interval;
+		profile.entries.clear();
+	}
+}
+
+
+config parse_config(const std::string &path, bool required) {
+	config ret{};
+
+	std::ifstream file{path, std::ios::binary};
+	if (not file.is_open()) {
+		if (required) {
+			throw std::runtime_error{std::format("failed to open config file '{}'", path)};
+		}
+		log_info() << "failed to open config file '" << path << "'!";
+		log_info() << "using default config.";
+		return ret;
+	}
+
+	try {
+		parse_config_file(file, &ret);
+	}
+	catch (std::runtime_error &err) {
+		throw std::runtime_error{std::format("{}: {}", path, err.what())};
+	}
+	finish_config(&ret);
+	return ret;
+}
+
+
+config parse_config(const std::vector<std::string> &layers) {
+	config ret{};
+
+	bool found = false;
+	for (auto &path : layers) {
+		std::ifstream file{path, std::ios::binary};
+		if (not file.is_open()) {
+			continue;
+		}
+		found = true;
+		try {
+			parse_config_file(file, &ret);
+		}
+		catch (std::runtime_error &err) {
+			throw std::runtime_error{std::format("{}: {}", path, err.what())};
+		}
+	}
+	if (not found) {
+		log_info() << "no config file found, using default config.";
+	}
+
+	finish_config(&ret);
+	return ret;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,375 @@
+/**
+ * the xautocfg configuration and its parser.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <X11/X.h>
+#include <X11/XKBlib.h>
+
+#include "session.h"
+
+
+namespace xautocfg {
+
+/**
+ * replace a keysym with another one on a keyboard.
+ * all rules of a keyboard are applied at once against its current map,
+ * so swapping two keys works.
+ */
+struct remap {
+	KeySym from;
+	KeySym to;
+
+	bool operator ==(const remap &) const = default;
+};
+
+
+/**
+ * xkb controls to change on a keyboard, besides the repeat rate.
+ * prepared at config load so it can be copied into a SetControls request.
+ */
+struct xkb_controls {
+	// boolean controls to change, and their new values
+	uint32_t affect_enabled = 0;
+	uint32_t enabled = 0;
+
+	// non-boolean controls to change
+	uint32_t change = 0;
+
+	uint16_t slow_keys_delay = 0;
+	uint16_t debounce_delay = 0;
+	uint8_t ignore_lock_mods = 0;
+
+	// bit set: key repeats
+	std::array<uint8_t, XkbPerKeyBitArraySize> per_key_repeat{};
+
+	void set_enabled(uint32_t ctrl, bool on) {
+		this->affect_enabled |= ctrl;
+		if (on) {
+			this->enabled |= ctrl;
+		} else {
+			this->enabled &= ~ctrl;
+		}
+	}
+};
+
+
+/**
+ * what to do with a lock modifier (caps lock, num lock)
+ * when a keyboard is connected.
+ */
+enum class lock_mode {
+	keep,  // leave it as the device has it
+	sync,  // take over the state of the core keyboard
+	on,
+	off,
+};
+
+
+/**
+ * skip a hook if it already succeeded for the same device.
+ */
+struct hook_memoize {
+	bool enabled = false;
+	// how long a success counts, 0 means forever
+	std::chrono::seconds ttl{0};
+};
+
+
+/**
+ * environment variables for hooks, besides XINPUTID.
+ * they are only looked up when the command mentions them.
+ */
+enum hook_var : uint32_t {
+	hook_var_name    = 1 << 0,
+	hook_var_vendor  = 1 << 1,
+	hook_var_product = 1 << 2,
+	hook_var_node    = 1 << 3,
+	hook_var_master  = 1 << 4,
+	hook_var_rule    = 1 << 5,
+};
+
+
+constexpr std::array<std::pair<std::string_view, hook_var>, 6> hook_var_names{{
+	{"XINPUTNAME", hook_var_name},
+	{"XINPUTVENDOR", hook_var_vendor},
+	{"XINPUTPRODUCT", hook_var_product},
+	{"XINPUTNODE", hook_var_node},
+	{"XINPUTMASTER", hook_var_master},
+	{"XAUTOCFG_RULE", hook_var_rule},
+}};
+
+
+struct hook_command {
+	// empty for the plain on_connect or on_disconnect
+	std::string name;
+	std::string command;
+	// hook_var bits of the variables the command uses
+	uint32_t vars = 0;
+	// names of the hooks of the same event that have to finish first
+	std::vector<std::string> after;
+
+	void set(const std::string &command) {
+		this->command = command;
+		this->vars = 0;
+		for (auto &[name, var] : hook_var_names) {
+			if (command.find(std::format("${}", name)) != std::string::npos
+			    or command.find(std::format("${{{}", name)) != std::string::npos) {
+				this->vars |= var;
+			}
+		}
+	}
+};
+
+
+/**
+ * the hooks of one event, from on_connect and on_connect.<name> entries.
+ * they all start at once, except those that come after others.
+ */
+struct hook_set {
+	std::vector<hook_command> hooks;
+	hook_memoize memoize;
+
+	bool empty() const {
+		return std::ranges::all_of(this->hooks, [](auto &hook) {
+			return hook.command.empty();
+		});
+	}
+
+	/**
+	 * the hook with this name, added if there's none yet.
+	 */
+	hook_command &get(const std::string &name) {
+		auto it = std::ranges::find(this->hooks, name, &hook_command::name);
+		if (it != this->hooks.end()) {
+			return *it;
+		}
+		hook_command &hook = this->hooks.emplace_back();
+		hook.name = name;
+		return hook;
+	}
+
+	/**
+	 * throws std::logic_error if a hook comes after one that doesn't exist,
+	 * or hooks come after each other in a cycle.
+	 */
+	void check() const;
+};
+
+
+/**
+ * color temperature in kelvin and brightness in percent of a monitor,
+ * by day and by night.
+ */
+struct color_settings {
+	int temperature = 6500;
+	int night_temperature = 6500;
+	int brightness = 100;
+	int night_brightness = 100;
+};
+
+
+/**
+ * which hooks to drop when too many are waiting.
+ */
+enum class shed_policy {
+	oldest,  // the longest waiting, they are the most outdated
+	newest,  // the ones that would be queued
+};
+
+
+struct config {
+	struct keyboard {
+		uint32_t delay = 200;
+		uint32_t interval = 20;
+		// section the settings come from
+		std::string rule = "keyboard";
+		hook_set on_connect;
+		hook_set on_disconnect;
+		// hooks running longer are terminated, 0 for no limit
+		std::chrono::seconds hook_timeout{0};
+		std::vector<remap> remaps;
+		xkb_controls controls;
+		lock_mode capslock = lock_mode::keep;
+		lock_mode numlock = lock_mode::keep;
+	} keyboard;
+
+	/**
+	 * X resource files to merge into RESOURCE_MANAGER, like xrdb -merge.
+	 */
+	struct resources {
+		std::vector<std::string> files;
+		// preprocessor, or empty to load the files as they are
+		std::string cpp = "cpp";
+		// Xft.dpi from the physical size of the primary monitor, kept up to date
+		bool dpi = false;
+		// Xcursor.size at 96 dpi, scaled along with Xft.dpi. 0 leaves it alone.
+		int cursor_size = 0;
+	} resources;
+
+	session_settings session;
+
+	/**
+	 * per-model keyboard settings compiled by xautocfg-compile,
+	 * applied on top of the device rules. empty for none.
+	 */
+	std::string quirks_db;
+
+	/**
+	 * limits of the hook runner, from [hooks].
+	 */
+	struct hooks {
+		// how many hook processes may run at the same time
+		uint32_t jobs = 4;
+		// how many events with hooks may wait to run, the rest is shed
+		uint32_t queue = 64;
+		shed_policy shed = shed_policy::oldest;
+	} hooks;
+
+	/**
+	 * gamma ramps of the monitors, from [color] and [color.<output>].
+	 * the night settings are faded in at dusk and faded out at dawn.
+	 */
+	struct color {
+		bool enabled = false;
+		color_settings settings;
+		// local time when the fades start, in minutes after midnight
+		int dusk = 19 * 60;
+		int dawn = 6 * 60;
+		// minutes a fade takes
+		int fade = 40;
+
+		/**
+		 * settings for a randr output, which inherit [color].
+		 */
+		struct output {
+			std::string name;
+			color_settings settings;
+
+			// entries are applied on top of [color] once the whole file is parsed
+			std::vector<std::pair<std::string, std::string>> entries;
+		};
+		std::vector<output> outputs;
+
+		const color_settings &settings_for(const std::string &output) const {
+			auto it = std::ranges::find(this->outputs, output, &output::name);
+			return it != this->outputs.end() ? it->settings : this->settings;
+		}
+	} color;
+
+	/**
+	 * settings for keyboards whose name or master device name matches a regex.
+	 * from [keyboard.<name>] sections, which inherit all [keyboard] settings.
+	 */
+	struct device_rule {
+		std::string name;
+		std::string match_src;
+		std::optional<std::regex> match;
+		std::string master_src;
+		std::optional<std::regex> master;
+		struct keyboard keyboard;
+
+		// entries are applied on top of [keyboard] once the whole file is parsed
+		std::vector<std::pair<std::string, std::string>> entries;
+
+		bool matches(const std::string &device_name, const std::string &master_name) const {
+			return (not this->match or std::regex_search(device_name, *this->match))
+			       and (not this->master or std::regex_search(master_name, *this->master));
+		}
+	};
+	std::vector<device_rule> device_rules;
+
+	/**
+	 * settings for the device with the given name, attached to the given master.
+	 * for master devices, pass their own name as master.
+	 * the first matching device rule wins.
+	 */
+	const struct keyboard &keyboard_for(const std::string &device_name,
+	                                    const std::string &master_name) const {
+		for (auto &rule : this->device_rules) {
+			if (rule.matches(device_name, master_name)) {
+				return rule.keyboard;
+			}
+		}
+		return this->keyboard;
+	}
+
+	/**
+	 * do we need to set up each slave keyboard on its own?
+	 */
+	bool per_device() const {
+		return not this->device_rules.empty() or not this->keyboard.remaps.empty()
+		       or not this->quirks_db.empty();
+	}
+
+	/**
+	 * repeat rate while a window whose WM_CLASS matches has the focus.
+	 * from [application.<name>] sections, defaults from [keyboard].
+	 */
+	struct app_profile {
+		std::string name;
+		std::string match_src;
+		std::regex match;
+		uint32_t delay;
+		uint32_t interval;
+
+		std::vector<std::pair<std::string, std::string>> entries;
+	};
+	std::vector<app_profile> app_profiles;
+
+	/**
+	 * index of the profile for a window class, -1 if none matches.
+	 */
+	int app_profile_for(const std::string &instance, const std::string &cls) const {
+		for (size_t i = 0; i < this->app_profiles.size(); i++) {
+			auto &match = this->app_profiles[i].match;
+			if (std::regex_search(instance, match) or std::regex_search(cls, match)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+};
+
+
+/**
+ * apply one 'key = value' entry of a [keyboard] section.
+ * throws std::logic_error for invalid entries.
+ */
+void parse_keyboard_entry(struct config::keyboard *keyboard,
+                          const std::string& key,
+                          const std::string& val);
+
+/**
+ * read a config file.
+ * if it doesn't exist and isn't required, the defaults are used.
+ * throws std::runtime_error for invalid content.
+ */
+config parse_config(const std::string &path, bool required = true);
+
+/**
+ * read config files that build on each other, e.g. system and user.
+ * sections of later files add to and override those of earlier ones,
+ * files that don't exist are skipped.
+ * throws std::runtime_error for invalid content.
+ */
+config parse_config(const std::vector<std::string> &layers);
+
+} // namespace xautocfg
@@ -0,0 +1,156 @@
+/**
+ * parsed configs shared by the displays of a user.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "xautocfg.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+
+#include "log.h"
+
+namespace xautocfg {
+
+config_source::config_source(config cfg)
+	:
+	snapshot{std::make_shared<const config>(std::move(cfg))} {}
+
+
+std::shared_ptr<const config> config_source::current() const {
+	return this->snapshot.load(std::memory_order_acquire);
+}
+
+
+void config_source::publish(config cfg) {
+	this->snapshot.store(std::make_shared<const config>(std::move(cfg)), std::memory_order_release);
+
+	std::lock_guard<std::mutex> lock{this->listeners_lock};
+	for (int fd : this->listeners) {
+		eventfd_write(fd, 1);
+	}
+}
+
+
+void config_source::add_listener(int eventfd) {
+	std::lock_guard<std::mutex> lock{this->listeners_lock};
+	this->listeners.push_back(eventfd);
+}
+
+
+void config_source::remove_listener(int eventfd) {
+	std::lock_guard<std::mutex> lock{this->listeners_lock};
+	std::erase(this->listeners, eventfd);
+}
+
+
+std::shared_ptr<config_source> config_cache::get(uid_t uid, const std::vector<std::string> &layers,
+                                                 bool required) {
+	auto it = std::ranges::find_if(this->entries, [&](const entry &entry) {
+		return entry.uid == uid and entry.layers == layers;
+	});
+
+	std::string version = config_cache::version(layers);
+	if (it != this->entries.end()) {
+		if (it->version != version) {
+			it->version = std::move(version);
+			try {
+				it->source->publish(config_cache::parse(*it));
+			}
+			catch (std::exception &err) {
+				log_error() << "failed to reload config: " << err.what();
+				log_error() << "keeping the previous config.";
+			}
+		}
+		return it->source;
+	}
+
+	entry added{uid, layers, required, std::move(version), nullptr};
+	added.source = std::make_shared<config_source>(config_cache::parse(added));
+	this->entries.push_back(std::move(added));
+	return this->entries.back().source;
+}
+
+
+size_t config_cache::reload() {
+	size_t ret = 0;
+	for (auto &entry : this->entries) {
+		std::string version = config_cache::version(entry.layers);
+		if (version == entry.version) {
+			continue;
+		}
+
+		try {
+			entry.source->publish(config_cache::parse(entry));
+			ret += 1;
+		}
+		catch (std::exception &err) {
+			log_error() << "failed to reload config: " << err.what();
+			log_error() << "keeping the previous config.";
+		}
+		// a broken file isn't tried again until it changes
+		entry.version = std::move(version);
+	}
+	return ret;
+}
+
+
+std::string config_cache::version(const std::vector<std::string> &layers) {
+	std::string ret;
+	for (auto &path : layers) {
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0) {
+			ret += "-;";
+			continue;
+		}
+		ret += std::format("{}:{}:{}:{}.{};", st.st_dev, st.st_ino, st.st_size,
+		                   st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+	}
+	return ret;
+}
+
+
+config config_cache::parse(const entry &entry) {
+	if (entry.required) {
+		return parse_config(entry.layers.at(0), true);
+	}
+	return parse_config(entry.layers);
+}
+
+
+std::vector<std::string> config_layers() {
+	std::vector<std::string> ret;
+
+	const char *dirs = std::getenv("XDG_CONFIG_DIRS");
+	std::string_view system = (dirs and *dirs) ? dirs : "/etc/xdg";
+	// listed most important first, so they're layered the other way round
+	while (not system.empty()) {
+		size_t end = std::min(system.find(':'), system.size());
+		if (end > 0) {
+			ret.insert(ret.begin(), std::format("{}/xautocfg.cfg", system.substr(0, end)));
+		}
+		system.remove_prefix(std::min(end + 1, system.size()));
+	}
+
+	const char *home = std::getenv("XDG_CONFIG_HOME");
+	if (home and *home) {
+		ret.push_back(std::format("{}/xautocfg.cfg", home));
+	}
+	else if ((home = std::getenv("HOME"))) {
+		ret.push_back(std::format("{}/.config/xautocfg.cfg", home));
+	}
+	return ret;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,173 @@
+/**
+ * table of the xinput devices.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "devices.h"
+
+#include <format>
+
+#include <X11/Xatom.h>
+#include <X11/extensions/XI2.h>
+
+
+namespace xautocfg {
+
+void device_table::load() {
+	int count = 0;
+	XIDeviceInfo *info = XIQueryDevice(this->display, XIAllDevices, &count);
+	if (not info) {
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		this->add(info[i].deviceid, &info[i]);
+	}
+	XIFreeDeviceInfo(info);
+}
+
+
+void device_table::update(const XIHierarchyInfo &hier) {
+	if (hier.flags & (XIMasterRemoved | XISlaveRemoved)) {
+		// device ids are reused for other devices
+		if (static_cast<size_t>(hier.deviceid) < this->hots.size()) {
+			this->hots[hier.deviceid] = {};
+			this->colds[hier.deviceid] = {};
+		}
+		return;
+	}
+
+	hot &dev = this->get(hier.deviceid);
+	dev.use = hier.use;
+	dev.attachment = hier.attachment;
+	dev.enabled = hier.enabled;
+}
+
+
+device_table::hot &device_table::get(int deviceid) {
+	if (static_cast<size_t>(deviceid) < this->hots.size()
+	    and this->hots[deviceid].generation != 0) {
+		return this->hots[deviceid];
+	}
+
+	// a device we didn't know about yet, or already gone again
+	int count = 0;
+	XIDeviceInfo *info = XIQueryDevice(this->display, deviceid, &count);
+	this->add(deviceid, (info and count > 0) ? info : nullptr);
+	if (info) {
+		// libXi doesn't check for null
+		XIFreeDeviceInfo(info);
+	}
+	return this->hots[deviceid];
+}
+
+
+device_table::cold &device_table::meta(int deviceid) {
+	this->get(deviceid);
+	return this->colds[deviceid];
+}
+
+
+std::string device_table::master_name(int deviceid) {
+	const hot &dev = this->get(deviceid);
+	switch (dev.use) {
+	case XIMasterKeyboard:
+	case XIMasterPointer:
+		return this->name(deviceid);
+	case XIFloatingSlave:
+		return "";
+	default:
+		return this->name(dev.attachment);
+	}
+}
+
+
+std::pair<uint32_t, uint32_t> device_table::product_id(int deviceid) {
+	cold &dev = this->meta(deviceid);
+	if (dev.product_id) {
+		return *dev.product_id;
+	}
+
+	if (this->product_id_atom == None) {
+		this->product_id_atom = XInternAtom(this->display, "Device Product ID", False);
+	}
+
+	dev.product_id.emplace(0, 0);
+	Atom type;
+	int format;
+	unsigned long count, remaining;
+	unsigned char *data = nullptr;
+	if (XIGetProperty(this->display, deviceid, this->product_id_atom, 0, 2, False,
+	                  XA_INTEGER, &type, &format, &count, &remaining, &data) == Success
+	    and type == XA_INTEGER and format == 32 and count == 2) {
+		auto *ids = reinterpret_cast<uint32_t *>(data);
+		dev.product_id.emplace(ids[0], ids[1]);
+	}
+	if (data) {
+		XFree(data);
+	}
+	return *dev.product_id;
+}
+
+
+const std::string &device_table::node(int deviceid) {
+	cold &dev = this->meta(deviceid);
+	if (dev.node) {
+		return *dev.node;
+	}
+
+	if (this->node_atom == None) {
+		this->node_atom = XInternAtom(this->display, "Device Node", False);
+	}
+
+	dev.node.emplace();
+	Atom type;
+	int format;
+	unsigned long count, remaining;
+	unsigned char *data = nullptr;
+	if (XIGetProperty(this->display, deviceid, this->node_atom, 0, 1024, False,
+	                  XA_STRING, &type, &format, &count, &remaining, &data) == Success
+	    and type == XA_STRING and format == 8) {
+		dev.node->assign(reinterpret_cast<char *>(data), count);
+	}
+	if (data) {
+		XFree(data);
+	}
+	return *dev.node;
+}
+
+
+std::string device_table::identity(int deviceid) {
+	auto [vendor, product] = this->product_id(deviceid);
+	return std::format("{:04x}:{:04x} {}", vendor, product, this->name(deviceid));
+}
+
+
+void device_table::forget_applied() {
+	for (hot &dev : this->hots) {
+		dev.applied = nullptr;
+	}
+}
+
+
+void device_table::add(int deviceid, const XIDeviceInfo *info) {
+	if (static_cast<size_t>(deviceid) >= this->hots.size()) {
+		this->hots.resize(deviceid + 1);
+		this->colds.resize(deviceid + 1);
+	}
+
+	hot &dev = this->hots[deviceid];
+	dev = {};
+	dev.generation = ++this->last_generation;
+	this->colds[deviceid] = {};
+	if (info) {
+		dev.use = info->use;
+		dev.attachment = info->attachment;
+		dev.enabled = info->enabled;
+		this->colds[deviceid].name = info->name;
+	}
+}
+
+} // namespace xautocfg
@@ -0,0 +1,135 @@
+/**
+ * table of the xinput devices.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#include "config.h"
+#include "keyboard.h"
+
+
+namespace xautocfg {
+
+/**
+ * the xinput devices and how they are attached.
+ * loaded once at startup and then kept up to date from hierarchy events,
+ * only devices that appear later are queried.
+ *
+ * indexed by device id, which the server keeps small and reuses.
+ * what scans over all devices need is in one compact array,
+ * names and lazily fetched metadata are kept apart from it.
+ */
+class device_table {
+public:
+	struct hot {
+		// changes whenever the id is given to another device, 0 while unused
+		uint32_t generation = 0;
+		uint16_t attachment = 0;
+		uint8_t use = 0;
+		bool enabled = false;
+		// keyboard settings last sent to the device
+		const struct config::keyboard *applied = nullptr;
+	};
+	static_assert(sizeof(hot) <= 16, "keep scans in few cache lines");
+
+	struct cold {
+		std::string name;
+
+		// fetched when needed
+		std::optional<std::pair<uint32_t, uint32_t>> product_id;
+		std::optional<std::string> node;
+
+		// settings with quirks applied, null if the device has none
+		bool quirks_checked = false;
+		std::unique_ptr<const struct config::keyboard> quirk_kbd;
+
+		// its keymap stays while it's disabled, e.g. during a vt switch,
+		// and is new with the next device that gets the id
+		keymap_remap keymap;
+	};
+
+	explicit device_table(Display *display)
+		:
+		display{display} {}
+
+	void load();
+
+	/**
+	 * apply one entry of a hierarchy event.
+	 */
+	void update(const XIHierarchyInfo &hier);
+
+	hot &get(int deviceid);
+	cold &meta(int deviceid);
+
+	const std::string &name(int deviceid) {
+		return this->meta(deviceid).name;
+	}
+
+	/**
+	 * name of the master device a device belongs to.
+	 * masters are their own master, floating slaves have none.
+	 */
+	std::string master_name(int deviceid);
+
+	/**
+	 * usb/bluetooth vendor and product id, 0 if unknown.
+	 * the first call for a device asks the server.
+	 */
+	std::pair<uint32_t, uint32_t> product_id(int deviceid);
+
+	/**
+	 * device file the server reads, like /dev/input/event3, or empty.
+	 * the first call for a device asks the server.
+	 */
+	const std::string &node(int deviceid);
+
+	/**
+	 * what identifies a physical device across reconnects.
+	 */
+	std::string identity(int deviceid);
+
+	/**
+	 * the config the applied settings point into is going away.
+	 */
+	void forget_applied();
+
+	template <typename F>
+	void for_each(int use, F &&func) {
+		for (size_t deviceid = 0; deviceid < this->hots.size(); deviceid++) {
+			const hot &dev = this->hots[deviceid];
+			if (dev.generation != 0 and dev.use == use and dev.enabled) {
+				func(deviceid);
+			}
+		}
+	}
+
+private:
+	/**
+	 * (re)initialize the entry of a device id, from info if given.
+	 */
+	void add(int deviceid, const XIDeviceInfo *info);
+
+	Display *display;
+	Atom product_id_atom = None;
+	Atom node_atom = None;
+	uint32_t last_generation = 0;
+	std::vector<hot> hots;
+	std::vector<cold> colds;
+};
+
+} // namespace xautocfg
@@ -0,0 +1,242 @@
+/**
+ * resolution dependent resources, following the primary monitor.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "dpi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <vector>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/randr.h>
+
+
+#include "log.h"
+
+namespace xautocfg {
+
+// projectors and tvs may report sizes that give values outside of this
+constexpr int min_dpi = 48;
+constexpr int max_dpi = 480;
+
+
+/**
+ * image size in mm from the base block of an EDID, {0, 0} if it has none.
+ * the preferred timing has it in mm, the basic display parameters only in cm.
+ */
+std::pair<int, int> edid_size_mm(const unsigned char *edid, size_t size) {
+	static constexpr unsigned char header[8] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+	if (size < 128 or not std::equal(header, header + 8, edid)) {
+		return {0, 0};
+	}
+
+	// a pixel clock of 0 means it's a display descriptor instead
+	const unsigned char *timing = edid + 54;
+	if (timing[0] or timing[1]) {
+		int width = timing[12] | ((timing[14] & 0xf0) << 4);
+		int height = timing[13] | ((timing[14] & 0x0f) << 8);
+		if (width > 0 and height > 0) {
+			return {width, height};
+		}
+	}
+
+	// if one is 0, the other is an aspect ratio
+	if (edid[21] and edid[22]) {
+		return {edid[21] * 10, edid[22] * 10};
+	}
+	return {0, 0};
+}
+
+
+dpi_tracker::dpi_tracker(Display *display, timer_wheel *timers, bool watch, callback on_change)
+	:
+	display{display},
+	root{DefaultRootWindow(display)},
+	timers{timers},
+	on_change{std::move(on_change)},
+	edid_atom{XInternAtom(display, RR_PROPERTY_RANDR_EDID, False)} {
+
+	// primary outputs and the current screen resources are 1.3
+	int error_base, major = 1, minor = 3;
+	if (not XRRQueryExtension(this->display, &this->event_base, &error_base)
+	    or not XRRQueryVersion(this->display, &major, &minor)
+	    or major < 1 or (major == 1 and minor < 3)) {
+		log_error() << "randr 1.3 is not available, can't derive the dpi";
+		return;
+	}
+	this->have_randr = true;
+
+	if (watch) {
+		XRRSelectInput(this->display, this->root, randr_event_mask);
+	}
+
+	this->dpi = this->measure();
+	if (this->dpi) {
+		log_info() << "primary monitor has " << this->dpi << " dpi";
+	}
+}
+
+
+dpi_tracker::~dpi_tracker() {
+	this->timers->cancel(this->settle);
+}
+
+
+bool dpi_tracker::handle_event(XEvent &event) {
+	if (not this->have_randr) {
+		return false;
+	}
+
+	if (event.type == this->event_base + RRScreenChangeNotify) {
+		// xlib's idea of the screen size
+		XRRUpdateConfiguration(&event);
+	}
+	else if (event.type == this->event_base + RRNotify) {
+		auto &notify = reinterpret_cast<XRRNotifyEvent &>(event);
+		if (notify.subtype == RRNotify_OutputChange) {
+			// maybe another monitor on the same output
+			this->edid_sizes.erase(reinterpret_cast<XRROutputChangeNotifyEvent &>(event).output);
+		}
+		else if (notify.subtype == RRNotify_OutputProperty) {
+			auto &prop = reinterpret_cast<XRROutputPropertyNotifyEvent &>(event);
+			if (prop.property != this->edid_atom) {
+				return true;
+			}
+			this->edid_sizes.erase(prop.output);
+		}
+	}
+	else {
+		return false;
+	}
+
+	// later events of the burst are handled by the same measurement
+	if (not this->timers->active(this->settle)) {
+		this->settle = this->timers->add(settle_delay, [this] {
+			this->settled();
+		});
+	}
+	return true;
+}
+
+
+resource_db dpi_tracker::resources(const struct config::resources &cfg) const {
+	resource_db ret;
+	if (this->dpi == 0) {
+		return ret;
+	}
+
+	ret["Xft.dpi"] = std::format("{}", this->dpi);
+	if (cfg.cursor_size > 0) {
+		ret["Xcursor.size"] = std::format("{}", (cfg.cursor_size * this->dpi + 48) / 96);
+	}
+	return ret;
+}
+
+
+void dpi_tracker::settled() {
+	int dpi = this->measure();
+	// without a usable monitor, the last values stay
+	if (dpi == 0 or dpi == this->dpi) {
+		return;
+	}
+
+	log_info() << "primary monitor dpi changed from " << this->dpi
+	           << " to " << dpi;
+	this->dpi = dpi;
+	this->on_change();
+}
+
+
+int dpi_tracker::measure() {
+	// doesn't probe the outputs, that's up to whoever configures them
+	XRRScreenResources *res = XRRGetScreenResourcesCurrent(this->display, this->root);
+	if (not res) {
+		return 0;
+	}
+
+	std::vector<RROutput> outputs;
+	RROutput primary = XRRGetOutputPrimary(this->display, this->root);
+	if (primary != None) {
+		outputs.push_back(primary);
+	}
+	outputs.insert(outputs.end(), res->outputs, res->outputs + res->noutput);
+
+	int ret = 0;
+	for (RROutput output : outputs) {
+		XRROutputInfo *info = XRRGetOutputInfo(this->display, res, output);
+		if (not info) {
+			continue;
+		}
+		if (info->connection == RR_Connected and info->crtc != None) {
+			if (XRRCrtcInfo *crtc = XRRGetCrtcInfo(this->display, res, info->crtc)) {
+				ret = this->output_dpi(output, *info, *crtc);
+				XRRFreeCrtcInfo(crtc);
+			}
+		}
+		XRRFreeOutputInfo(info);
+		if (ret) {
+			break;
+		}
+	}
+
+	XRRFreeScreenResources(res);
+	return ret;
+}
+
+
+int dpi_tracker::output_dpi(RROutput output, const XRROutputInfo &info, const XRRCrtcInfo &crtc) {
+	auto [mm_width, mm_height] = this->physical_size(output, info);
+	if (mm_width <= 0 or mm_height <= 0 or crtc.width == 0 or crtc.height == 0) {
+		return 0;
+	}
+
+	// along the diagonal, so rotation doesn't matter
+	double pixels = std::hypot(crtc.width, crtc.height);
+	double inches = std::hypot(mm_width, mm_height) / 25.4;
+	int dpi = std::lround(pixels / inches);
+	if (dpi < min_dpi or dpi > max_dpi) {
+		return 0;
+	}
+	return dpi;
+}
+
+
+std::pair<int, int> dpi_tracker::physical_size(RROutput output, const XRROutputInfo &info) {
+	auto it = this->edid_sizes.find(output);
+	if (it == this->edid_sizes.end()) {
+		std::pair<int, int> size{0, 0};
+
+		// the base block is enough, extensions don't have the size
+		Atom type;
+		int format;
+		unsigned long count, remaining;
+		unsigned char *data = nullptr;
+		if (XRRGetOutputProperty(this->display, output, this->edid_atom, 0, 128 / 4,
+		                         False, False, AnyPropertyType,
+		                         &type, &format, &count, &remaining, &data) == Success
+		    and data) {
+			if (format == 8) {
+				size = edid_size_mm(data, count);
+			}
+			XFree(data);
+		}
+		it = this->edid_sizes.emplace(output, size).first;
+	}
+
+	if (it->second.first > 0) {
+		return it->second;
+	}
+	// the driver's idea, usually from the same EDID
+	return {static_cast<int>(info.mm_width), static_cast<int>(info.mm_height)};
+}
+
+} // namespace xautocfg
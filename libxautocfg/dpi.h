@@ -0,0 +1,101 @@
+/**
+ * resolution dependent resources, following the primary monitor.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "config.h"
+#include "resources.h"
+#include "timers.h"
+
+
+namespace xautocfg {
+
+/**
+ * randr events on the root window, for everything that follows the monitors.
+ * a selection replaces the previous one of the connection, so all select the same.
+ */
+constexpr int randr_event_mask = RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask
+                                 | RROutputChangeNotifyMask | RROutputPropertyNotifyMask;
+
+
+/**
+ * derives Xft.dpi and Xcursor.size from the physical size of the primary monitor.
+ *
+ * the size is taken from the EDID of the output, which is only
+ * fetched again when the server reports that it changed.
+ * randr events come in bursts, e.g. when docking,
+ * they are handled once after they settle.
+ */
+class dpi_tracker {
+public:
+	using callback = std::function<void()>;
+
+	/**
+	 * with watch, on_change is called when randr events changed the dpi.
+	 */
+	dpi_tracker(Display *display, timer_wheel *timers, bool watch, callback on_change);
+	~dpi_tracker();
+
+	dpi_tracker(const dpi_tracker &) = delete;
+	dpi_tracker &operator =(const dpi_tracker &) = delete;
+
+	/**
+	 * process an event, false if it isn't from randr.
+	 */
+	bool handle_event(XEvent &event);
+
+	/**
+	 * the derived resources, empty while the dpi is unknown.
+	 */
+	resource_db resources(const struct config::resources &cfg) const;
+
+private:
+	static constexpr std::chrono::milliseconds settle_delay{250};
+
+	/**
+	 * measure again after events, tell if it changed.
+	 */
+	void settled();
+
+	/**
+	 * dpi of the primary monitor, or the first active one without primary.
+	 * 0 if it can't be known.
+	 */
+	int measure();
+
+	int output_dpi(RROutput output, const XRROutputInfo &info, const XRRCrtcInfo &crtc);
+
+	/**
+	 * image size in mm, from the cached EDID or the server.
+	 */
+	std::pair<int, int> physical_size(RROutput output, const XRROutputInfo &info);
+
+	Display *display;
+	Window root;
+	timer_wheel *timers;
+	callback on_change;
+	Atom edid_atom;
+
+	bool have_randr = false;
+	int event_base = 0;
+	timer_wheel::handle settle;
+
+	int dpi = 0;
+	// image size from the EDID of each output, {0, 0} if it has none
+	std::unordered_map<RROutput, std::pair<int, int>> edid_sizes;
+};
+
+} // namespace xautocfg
@@ -0,0 +1,469 @@
+/**
+ * snapshot of the input state of a display, for bug reports.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "xautocfg.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/uio.h>
+
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include <X11/extensions/XI2.h>
+#include <X11/extensions/XI2proto.h>
+#include <X11/extensions/XKB.h>
+#include <X11/extensions/XKBproto.h>
+
+
+namespace xautocfg {
+
+namespace {
+
+// xcb keeps the extension opcodes with these
+xcb_extension_t xinput_ext{"XInputExtension", 0};
+xcb_extension_t xkb_ext{"XKEYBOARD", 0};
+
+
+struct free_reply {
+	void operator ()(void *reply) const {
+		std::free(reply);
+	}
+};
+
+template <typename T>
+using reply_ptr = std::unique_ptr<T, free_reply>;
+
+
+/**
+ * sends extension requests without waiting for their replies.
+ * xcb queues the replies, so they can be collected in any order later.
+ */
+class pipeline {
+public:
+	explicit pipeline(xcb_connection_t *conn)
+		:
+		conn{conn} {}
+
+	/**
+	 * the request struct has the minor opcode in its second byte,
+	 * xcb fills in the major opcode and the length.
+	 */
+	template <typename Req>
+	unsigned int send(xcb_extension_t *ext, Req req) {
+		// xcb may use the two iovecs in front
+		iovec parts[3];
+		parts[2].iov_base = &req;
+		parts[2].iov_len = sizeof(req);
+		xcb_protocol_request_t info{1, ext, reinterpret_cast<uint8_t *>(&req)[1], 0};
+		return xcb_send_request(this->conn, XCB_REQUEST_CHECKED, parts + 2, &info);
+	}
+
+	/**
+	 * the reply to a request, null if it failed.
+	 */
+	template <typename Reply>
+	reply_ptr<Reply> wait(unsigned int sequence) {
+		xcb_generic_error_t *error = nullptr;
+		void *reply = xcb_wait_for_reply(this->conn, sequence, &error);
+		std::free(error);
+		return reply_ptr<Reply>{static_cast<Reply *>(reply)};
+	}
+
+private:
+	xcb_connection_t *conn;
+};
+
+
+std::string json_string(std::string_view str) {
+	std::string ret = "\"";
+	for (unsigned char c : str) {
+		if (c == '"' or c == '\\') {
+			ret += '\\';
+			ret += c;
+		}
+		else if (c < 0x20) {
+			ret += std::format("\\u{:04x}", c);
+		}
+		else {
+			ret += c;
+		}
+	}
+	ret += '"';
+	return ret;
+}
+
+
+const char *device_use_name(int use) {
+	switch (use) {
+	case XIMasterPointer:  return "master pointer";
+	case XIMasterKeyboard: return "master keyboard";
+	case XISlavePointer:   return "slave pointer";
+	case XISlaveKeyboard:  return "slave keyboard";
+	case XIFloatingSlave:  return "floating slave";
+	}
+	return "unknown";
+}
+
+
+constexpr std::array<std::pair<uint32_t, std::string_view>, 11> xkb_control_names{{
+	{XkbRepeatKeysMask, "repeat_keys"},
+	{XkbSlowKeysMask, "slow_keys"},
+	{XkbBounceKeysMask, "bounce_keys"},
+	{XkbStickyKeysMask, "sticky_keys"},
+	{XkbMouseKeysMask, "mouse_keys"},
+	{XkbMouseKeysAccelMask, "mouse_keys_accel"},
+	{XkbAccessXKeysMask, "access_x_keys"},
+	{XkbAccessXTimeoutMask, "access_x_timeout"},
+	{XkbAccessXFeedbackMask, "access_x_feedback"},
+	{XkbAudibleBellMask, "audible_bell"},
+	{XkbOverlay1Mask, "overlay1"},
+}};
+
+
+struct device_state {
+	uint16_t id = 0;
+	uint16_t use = 0;
+	uint16_t attachment = 0;
+	bool enabled = false;
+	std::string name;
+
+	unsigned int properties_request = 0;
+	unsigned int controls_request = 0;
+	reply_ptr<xkbGetControlsReply> controls;
+
+	struct property {
+		uint32_t atom;
+		unsigned int request;
+		reply_ptr<xXIGetPropertyReply> value;
+	};
+	std::vector<property> properties;
+};
+
+
+/**
+ * the devices in an XIQueryDevice reply.
+ */
+std::vector<device_state> parse_devices(const xXIQueryDeviceReply *reply) {
+	std::vector<device_state> ret;
+	const uint8_t *pos = reinterpret_cast<const uint8_t *>(reply + 1);
+	const uint8_t *end = pos + reply->length * 4;
+
+	for (size_t i = 0; i < reply->num_devices and pos + sizeof(xXIDeviceInfo) <= end; i++) {
+		xXIDeviceInfo info;
+		std::memcpy(&info, pos, sizeof(info));
+		pos += sizeof(info);
+
+		size_t name_len = std::min<size_t>(info.name_len, end - pos);
+		device_state &dev = ret.emplace_back();
+		dev.id = info.deviceid;
+		dev.use = info.use;
+		dev.attachment = info.attachment;
+		dev.enabled = info.enabled != 0;
+		dev.name.assign(reinterpret_cast<const char *>(pos), name_len);
+		pos += (info.name_len + 3) / 4 * 4;
+
+		// classes aren't part of the dump
+		for (size_t c = 0; c < info.num_classes and pos + sizeof(xXIAnyInfo) <= end; c++) {
+			xXIAnyInfo any;
+			std::memcpy(&any, pos, sizeof(any));
+			pos += std::max<size_t>(any.length, 1) * 4;
+		}
+	}
+	return ret;
+}
+
+
+/**
+ * fetch the names of atoms that aren't known yet, all in one round trip.
+ */
+void fetch_atom_names(xcb_connection_t *conn, const std::vector<uint32_t> &atoms,
+                      std::unordered_map<uint32_t, std::string> *names) {
+	std::unordered_map<uint32_t, xcb_get_atom_name_cookie_t> cookies;
+	for (uint32_t atom : atoms) {
+		if (atom != XCB_ATOM_NONE and not names->contains(atom) and not cookies.contains(atom)) {
+			cookies.emplace(atom, xcb_get_atom_name(conn, atom));
+		}
+	}
+	for (auto &[atom, cookie] : cookies) {
+		reply_ptr<xcb_get_atom_name_reply_t> reply{xcb_get_atom_name_reply(conn, cookie, nullptr)};
+		if (reply) {
+			(*names)[atom] = std::string{xcb_get_atom_name_name(reply.get()),
+			                             static_cast<size_t>(xcb_get_atom_name_name_length(reply.get()))};
+		}
+	}
+}
+
+
+void write_property(std::ostream &out, const xXIGetPropertyReply &prop, uint32_t float_atom,
+                    const std::unordered_map<uint32_t, std::string> &names) {
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(&prop + 1);
+
+	if (prop.format == 8 and prop.type == XCB_ATOM_STRING) {
+		std::string_view str{reinterpret_cast<const char *>(data), prop.num_items};
+		// lists of strings are separated by null bytes
+		while (str.ends_with('\0')) {
+			str.remove_suffix(1);
+		}
+		out << json_string(str);
+		return;
+	}
+
+	out << "[";
+	for (size_t i = 0; i < prop.num_items; i++) {
+		out << (i ? ", " : "");
+		if (prop.format == 8) {
+			uint8_t val = data[i];
+			if (prop.type == XCB_ATOM_INTEGER) {
+				out << static_cast<int>(static_cast<int8_t>(val));
+			}
+			else {
+				out << static_cast<unsigned>(val);
+			}
+		}
+		else if (prop.format == 16) {
+			uint16_t val;
+			std::memcpy(&val, data + i * 2, 2);
+			if (prop.type == XCB_ATOM_INTEGER) {
+				out << static_cast<int16_t>(val);
+			}
+			else {
+				out << val;
+			}
+		}
+		else {
+			uint32_t val;
+			std::memcpy(&val, data + i * 4, 4);
+			if (prop.type == XCB_ATOM_INTEGER) {
+				out << static_cast<int32_t>(val);
+			}
+			else if (prop.type == float_atom) {
+				float f;
+				std::memcpy(&f, &val, 4);
+				out << f;
+			}
+			else if (prop.type == XCB_ATOM_ATOM) {
+				auto it = names.find(val);
+				out << (it != names.end() ? json_string(it->second) : "null");
+			}
+			else {
+				out << val;
+			}
+		}
+	}
+	out << "]";
+}
+
+
+void write_controls(std::ostream &out, const xkbGetControlsReply &ctrls) {
+	out << "{\"repeat_delay\": " << ctrls.repeatDelay
+	    << ", \"repeat_interval\": " << ctrls.repeatInterval
+	    << ", \"slow_keys_delay\": " << ctrls.slowKeysDelay
+	    << ", \"debounce_delay\": " << ctrls.debounceDelay
+	    << ", \"ignore_lock_mods\": " << static_cast<unsigned>(ctrls.ignoreLockMods)
+	    << ", \"enabled\": [";
+
+	bool first = true;
+	for (auto &[mask, name] : xkb_control_names) {
+		if (ctrls.enabledCtrls & mask) {
+			out << (first ? "" : ", ") << json_string(name);
+			first = false;
+		}
+	}
+
+	// same notation as norepeat in the config
+	out << "], \"norepeat\": [";
+	first = true;
+	for (unsigned kc = 0; kc < XkbPerKeyBitArraySize * 8; kc++) {
+		if (not (ctrls.perKeyRepeat[kc / 8] & (1 << (kc % 8)))) {
+			out << (first ? "" : ", ") << kc;
+			first = false;
+		}
+	}
+	out << "]}";
+}
+
+} // namespace
+
+
+void dump_state(const char *display, std::ostream &out) {
+	xcb_connection_t *conn = xcb_connect(display, nullptr);
+	std::unique_ptr<xcb_connection_t, decltype(&xcb_disconnect)> conn_guard{conn, xcb_disconnect};
+	if (xcb_connection_has_error(conn)) {
+		const char *name = display ? display : std::getenv("DISPLAY");
+		throw std::runtime_error{std::format("failed to connect to x display '{}'", name ? name : "")};
+	}
+
+	// replies depend on each other in four steps, each step
+	// sends all its requests before waiting for any reply.
+	// so it takes the same number of round trips for any number of devices.
+	pipeline pipe{conn};
+
+	// first: the server settings and the extensions, which are needed for everything else
+	xcb_prefetch_extension_data(conn, &xinput_ext);
+	xcb_prefetch_extension_data(conn, &xkb_ext);
+	auto keyboard_cookie = xcb_get_keyboard_control(conn);
+	auto pointer_cookie = xcb_get_pointer_control(conn);
+	auto saver_cookie = xcb_get_screen_saver(conn);
+	auto float_cookie = xcb_intern_atom(conn, true, 5, "FLOAT");
+
+	const xcb_query_extension_reply_t *xi = xcb_get_extension_data(conn, &xinput_ext);
+	if (not xi or not xi->present) {
+		throw std::runtime_error{"no xinput extension"};
+	}
+	const xcb_query_extension_reply_t *xkb = xcb_get_extension_data(conn, &xkb_ext);
+	bool have_xkb = xkb and xkb->present;
+
+	// both have to be announced before their other requests
+	unsigned int version_request = pipe.send(&xinput_ext, xXIQueryVersionReq{
+		0, X_XIQueryVersion, 0, XI_2_Major, XI_2_Minor});
+	unsigned int xkb_request = 0;
+	if (have_xkb) {
+		xkb_request = pipe.send(&xkb_ext, xkbUseExtensionReq{
+			0, X_kbUseExtension, 0, XkbMajorVersion, XkbMinorVersion});
+	}
+	unsigned int devices_request = pipe.send(&xinput_ext, xXIQueryDeviceReq{
+		0, X_XIQueryDevice, 0, XIAllDevices, 0});
+
+	pipe.wait<void>(version_request);
+	if (have_xkb) {
+		have_xkb = pipe.wait<xkbUseExtensionReply>(xkb_request) != nullptr;
+	}
+	auto devices_reply = pipe.wait<xXIQueryDeviceReply>(devices_request);
+	if (not devices_reply) {
+		throw std::runtime_error{"failed to query input devices"};
+	}
+	std::vector<device_state> devices = parse_devices(devices_reply.get());
+
+	// second: the property lists and the xkb controls of each device
+	for (auto &dev : devices) {
+		dev.properties_request = pipe.send(&xinput_ext, xXIListPropertiesReq{
+			0, X_XIListProperties, 0, dev.id, 0});
+		if (have_xkb and (dev.use == XIMasterKeyboard or dev.use == XISlaveKeyboard)) {
+			dev.controls_request = pipe.send(&xkb_ext, xkbGetControlsReq{
+				0, X_kbGetControls, 0, dev.id, 0});
+		}
+	}
+
+	std::vector<uint32_t> atoms;
+	for (auto &dev : devices) {
+		auto list = pipe.wait<xXIListPropertiesReply>(dev.properties_request);
+		if (dev.controls_request) {
+			dev.controls = pipe.wait<xkbGetControlsReply>(dev.controls_request);
+		}
+		if (not list) {
+			continue;
+		}
+		const uint32_t *props = reinterpret_cast<const uint32_t *>(list.get() + 1);
+		for (size_t i = 0; i < list->num_properties and i < list->length; i++) {
+			dev.properties.push_back({props[i], 0, {}});
+			atoms.push_back(props[i]);
+		}
+	}
+
+	// third: the property values, and the names of the properties
+	for (auto &dev : devices) {
+		for (auto &prop : dev.properties) {
+			xXIGetPropertyReq req{};
+			req.ReqType = X_XIGetProperty;
+			req.deviceid = dev.id;
+			req.property = prop.atom;
+			req.type = XCB_GET_PROPERTY_TYPE_ANY;
+			// in 4 byte units, far more than any property has
+			req.len = 1 << 16;
+			prop.request = pipe.send(&xinput_ext, req);
+		}
+	}
+
+	std::unordered_map<uint32_t, std::string> names;
+	fetch_atom_names(conn, atoms, &names);
+
+	// fourth: atoms that are in the values
+	atoms.clear();
+	for (auto &dev : devices) {
+		for (auto &prop : dev.properties) {
+			prop.value = pipe.wait<xXIGetPropertyReply>(prop.request);
+			if (prop.value and prop.value->format == 32 and prop.value->type == XCB_ATOM_ATOM) {
+				const uint32_t *values = reinterpret_cast<const uint32_t *>(prop.value.get() + 1);
+				atoms.insert(atoms.end(), values, values + prop.value->num_items);
+			}
+		}
+	}
+	fetch_atom_names(conn, atoms, &names);
+
+	reply_ptr<xcb_get_keyboard_control_reply_t> keyboard{xcb_get_keyboard_control_reply(conn, keyboard_cookie, nullptr)};
+	reply_ptr<xcb_get_pointer_control_reply_t> pointer{xcb_get_pointer_control_reply(conn, pointer_cookie, nullptr)};
+	reply_ptr<xcb_get_screen_saver_reply_t> saver{xcb_get_screen_saver_reply(conn, saver_cookie, nullptr)};
+	reply_ptr<xcb_intern_atom_reply_t> float_reply{xcb_intern_atom_reply(conn, float_cookie, nullptr)};
+	uint32_t float_atom = float_reply ? float_reply->atom : uint32_t{XCB_ATOM_NONE};
+
+	out << "{\n";
+	if (keyboard) {
+		out << "  \"keyboard\": {\"auto_repeat\": " << (keyboard->global_auto_repeat ? "true" : "false")
+		    << ", \"key_click_percent\": " << static_cast<unsigned>(keyboard->key_click_percent)
+		    << ", \"bell_percent\": " << static_cast<unsigned>(keyboard->bell_percent)
+		    << ", \"bell_pitch\": " << keyboard->bell_pitch
+		    << ", \"bell_duration\": " << keyboard->bell_duration
+		    << ", \"led_mask\": " << keyboard->led_mask << "},\n";
+	}
+	if (pointer) {
+		out << "  \"pointer\": {\"accel_numerator\": " << pointer->acceleration_numerator
+		    << ", \"accel_denominator\": " << pointer->acceleration_denominator
+		    << ", \"threshold\": " << pointer->threshold << "},\n";
+	}
+	if (saver) {
+		out << "  \"screensaver\": {\"timeout\": " << saver->timeout
+		    << ", \"interval\": " << saver->interval
+		    << ", \"prefer_blanking\": " << static_cast<unsigned>(saver->prefer_blanking)
+		    << ", \"allow_exposures\": " << static_cast<unsigned>(saver->allow_exposures) << "},\n";
+	}
+
+	out << "  \"devices\": [";
+	for (size_t i = 0; i < devices.size(); i++) {
+		auto &dev = devices[i];
+		out << (i ? "," : "") << "\n    {\"id\": " << dev.id
+		    << ", \"name\": " << json_string(dev.name)
+		    << ", \"use\": " << json_string(device_use_name(dev.use))
+		    << ", \"attachment\": " << dev.attachment
+		    << ", \"enabled\": " << (dev.enabled ? "true" : "false");
+		if (dev.controls) {
+			out << ",\n     \"xkb\": ";
+			write_controls(out, *dev.controls);
+		}
+		out << ",\n     \"properties\": {";
+		bool first = true;
+		for (auto &prop : dev.properties) {
+			auto name = names.find(prop.atom);
+			if (not prop.value or name == names.end()) {
+				continue;
+			}
+			out << (first ? "" : ",") << "\n      " << json_string(name->second) << ": ";
+			write_property(out, *prop.value, float_atom, names);
+			first = false;
+		}
+		out << (first ? "" : "\n     ") << "}}";
+	}
+	out << "\n  ]\n}" << std::endl;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,114 @@
+/**
+ * application profiles, following the focused window.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "focus.h"
+
+
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+
+#include "log.h"
+
+namespace xautocfg {
+
+focus_tracker::focus_tracker(Display *display, const config *cfg, callback on_switch)
+	:
+	display{display},
+	cfg{cfg},
+	on_switch{std::move(on_switch)},
+	root{DefaultRootWindow(display)},
+	net_active_window{XInternAtom(display, "_NET_ACTIVE_WINDOW", False)} {
+
+	XSelectInput(this->display, this->root, PropertyChangeMask);
+
+	// a window may already be focused, we only hear about the next one
+	this->focus_changed(true);
+}
+
+
+void focus_tracker::handle_event(const XEvent &event) {
+	if (event.type == DestroyNotify) {
+		this->profiles.erase(event.xdestroywindow.window);
+	}
+	else if (event.type == PropertyNotify
+	         and event.xproperty.window == this->root
+	         and event.xproperty.atom == this->net_active_window) {
+		this->focus_changed();
+	}
+}
+
+
+void focus_tracker::focus_changed(bool initial) {
+	Window active = this->active_window();
+	int profile = -1;
+
+	if (active != None) {
+		auto it = this->profiles.find(active);
+		if (it != this->profiles.end()) {
+			profile = it->second;
+		}
+		else {
+			profile = this->lookup_profile(active);
+			// we get a DestroyNotify to drop the cache entry
+			XSelectInput(this->display, active, StructureNotifyMask);
+			this->profiles.emplace(active, profile);
+		}
+	}
+
+	if (profile == this->active_profile and not initial) {
+		return;
+	}
+	this->active_profile = profile;
+
+	const config::app_profile *app = nullptr;
+	if (profile >= 0) {
+		app = &this->cfg->app_profiles[profile];
+		log_info() << "switching to application profile '" << app->name << "'";
+	}
+	else if (not initial) {
+		log_info() << "switching to default repeat rate";
+	}
+
+	this->on_switch(app);
+}
+
+
+Window focus_tracker::active_window() {
+	Atom type;
+	int format;
+	unsigned long count, remaining;
+	unsigned char *data = nullptr;
+	Window ret = None;
+
+	if (XGetWindowProperty(this->display, this->root, this->net_active_window,
+	                       0, 1, False, XA_WINDOW, &type, &format,
+	                       &count, &remaining, &data) == Success
+	    and type == XA_WINDOW and format == 32 and count == 1) {
+		ret = *reinterpret_cast<Window *>(data);
+	}
+	if (data) {
+		XFree(data);
+	}
+	return ret;
+}
+
+
+int focus_tracker::lookup_profile(Window window) {
+	XClassHint hint{};
+	if (not XGetClassHint(this->display, window, &hint)) {
+		return -1;
+	}
+	int ret = this->cfg->app_profile_for(hint.res_name ? hint.res_name : "",
+	                                     hint.res_class ? hint.res_class : "");
+	XFree(hint.res_name);
+	XFree(hint.res_class);
+	return ret;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,59 @@
+/**
+ * application profiles, following the focused window.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+
+#include <X11/Xlib.h>
+
+#include "config.h"
+
+
+namespace xautocfg {
+
+/**
+ * follows the focused window and reports the application profile it has.
+ * the owner switches the repeat rate of the keyboards.
+ */
+class focus_tracker {
+public:
+	/**
+	 * called with the profile of the focused window, nullptr for none.
+	 */
+	using callback = std::function<void(const config::app_profile *)>;
+
+	/**
+	 * the focused window is checked right away,
+	 * so on_switch is called once from here.
+	 */
+	focus_tracker(Display *display, const config *cfg, callback on_switch);
+
+	/**
+	 * process a PropertyNotify or DestroyNotify.
+	 */
+	void handle_event(const XEvent &event);
+
+private:
+	void focus_changed(bool initial = false);
+	Window active_window();
+	int lookup_profile(Window window);
+
+	Display *display;
+	const config *cfg;
+	callback on_switch;
+	Window root;
+	Atom net_active_window;
+
+	// profile index for each window we've seen focused
+	std::unordered_map<Window, int> profiles;
+	int active_profile = -1;
+};
+
+} // namespace xautocfg
@@ -0,0 +1,140 @@
+/**
+ * gamma ramps for color temperature and brightness.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "gamma.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__) or defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+namespace xautocfg {
+
+/**
+ * fit of the black body curve by tanner helland, valid from 1000 to 40000 kelvin.
+ */
+std::array<float, 3> blackbody(int temperature) {
+	double t = temperature / 100.0;
+	double r, g, b;
+	if (t <= 66) {
+		r = 1;
+		g = 0.39008157876901960784 * std::log(t) - 0.63184144378862745098;
+		b = t <= 19 ? 0 : 0.54320678911019607843 * std::log(t - 10) - 1.19625408914;
+	}
+	else {
+		r = 1.29293618606274509804 * std::pow(t - 60, -0.1332047592);
+		g = 1.12989086089529411765 * std::pow(t - 60, -0.0755148492);
+		b = 1;
+	}
+	return {
+		static_cast<float>(std::clamp(r, 0.0, 1.0)),
+		static_cast<float>(std::clamp(g, 0.0, 1.0)),
+		static_cast<float>(std::clamp(b, 0.0, 1.0)),
+	};
+}
+
+
+std::array<float, 3> whitepoint(int temperature) {
+	// the fit is a bit off white at 6500
+	static const std::array<float, 3> white = blackbody(6500);
+	std::array<float, 3> ret = blackbody(temperature);
+	for (size_t c = 0; c < ret.size(); c++) {
+		ret[c] = std::min(ret[c] / white[c], 1.f);
+	}
+	return ret;
+}
+
+
+void fill_ramp(uint16_t *ramp, size_t size, float top) {
+	if (size == 0) {
+		return;
+	}
+	float step = gamma_ramp::step(size, top);
+	size_t i = 0;
+
+	// all paths compute round(i * step) the same way, so they give the same ramp.
+	// make check compares them.
+#if defined(__AVX2__)
+	i = gamma_ramp::fill_avx2(ramp, i, size, step);
+#endif
+#if defined(__SSE2__)
+	i = gamma_ramp::fill_sse2(ramp, i, size, step);
+#endif
+	gamma_ramp::fill_scalar(ramp, i, size, step);
+}
+
+
+namespace gamma_ramp {
+
+float step(size_t size, float top) {
+	return size > 1 ? std::clamp(top, 0.f, 1.f) * 65535.f / (size - 1) : 0.f;
+}
+
+
+size_t fill_scalar(uint16_t *ramp, size_t begin, size_t size, float step) {
+	for (size_t i = begin; i < size; i++) {
+		float val = static_cast<float>(i) * step + 0.5f;
+		ramp[i] = static_cast<uint16_t>(std::min(static_cast<int32_t>(val), 65535));
+	}
+	return size;
+}
+
+
+#if defined(__SSE2__)
+size_t fill_sse2(uint16_t *ramp, size_t begin, size_t size, float step) {
+	const __m128 steps = _mm_set1_ps(step);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 eight = _mm_set1_ps(8.f);
+	const __m128i bias = _mm_set1_epi32(0x8000);
+	const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+	float first = begin;
+	__m128 lo = _mm_add_ps(_mm_set1_ps(first), _mm_setr_ps(0, 1, 2, 3));
+	__m128 hi = _mm_add_ps(_mm_set1_ps(first), _mm_setr_ps(4, 5, 6, 7));
+	size_t i = begin;
+	for (; i + 8 <= size; i += 8) {
+		__m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(lo, steps), half));
+		__m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(hi, steps), half));
+		// sse2 only packs to signed, so shift the range there and back
+		__m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(ramp + i), _mm_xor_si128(packed, flip));
+		lo = _mm_add_ps(lo, eight);
+		hi = _mm_add_ps(hi, eight);
+	}
+	return i;
+}
+#endif
+
+
+#if defined(__AVX2__)
+size_t fill_avx2(uint16_t *ramp, size_t begin, size_t size, float step) {
+	const __m256 steps = _mm256_set1_ps(step);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 sixteen = _mm256_set1_ps(16.f);
+	float first = begin;
+	__m256 lo = _mm256_add_ps(_mm256_set1_ps(first), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256 hi = _mm256_add_ps(_mm256_set1_ps(first), _mm256_setr_ps(8, 9, 10, 11, 12, 13, 14, 15));
+	size_t i = begin;
+	for (; i + 16 <= size; i += 16) {
+		__m256i a = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(lo, steps), half));
+		__m256i b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(hi, steps), half));
+		// packs within each 128 bit lane, the permute puts the halves in order
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0b11011000);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(ramp + i), packed);
+		lo = _mm256_add_ps(lo, sixteen);
+		hi = _mm256_add_ps(hi, sixteen);
+	}
+	return i;
+}
+#endif
+
+} // namespace gamma_ramp
+
+} // namespace xautocfg
@@ -0,0 +1,54 @@
+/**
+ * gamma ramps for color temperature and brightness.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace xautocfg {
+
+/**
+ * relative intensity of red, green and blue of a black body
+ * at a color temperature in kelvin, white at 6500.
+ */
+std::array<float, 3> whitepoint(int temperature);
+
+/**
+ * fill a gamma ramp that rises linearly from 0 to top * 65535.
+ * top is at most 1.
+ * vectorized with avx2 or sse2 if the build has them.
+ */
+void fill_ramp(uint16_t *ramp, size_t size, float top);
+
+
+/**
+ * the parts of fill_ramp, separate so tests and benchmarks can compare them.
+ * entry i of the ramp is round(i * step).
+ */
+namespace gamma_ramp {
+
+float step(size_t size, float top);
+
+/**
+ * fill from begin up to size, the vectorized ones only while whole blocks fit.
+ * return where they stopped.
+ */
+size_t fill_scalar(uint16_t *ramp, size_t begin, size_t size, float step);
+#if defined(__SSE2__)
+size_t fill_sse2(uint16_t *ramp, size_t begin, size_t size, float step);
+#endif
+#if defined(__AVX2__)
+size_t fill_avx2(uint16_t *ramp, size_t begin, size_t size, float step);
+#endif
+
+} // namespace gamma_ramp
+
+} // namespace xautocfg
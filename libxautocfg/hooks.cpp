@@ -0,0 +1,515 @@
+/**
+ * running hook commands in the background.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "hooks.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "log.h"
+#include "util.h"
+
+
+namespace xautocfg {
+
+hook_memo::hook_memo()
+	:
+	path{xdg_path("XDG_STATE_HOME", ".local/state", "memo")} {
+
+	this->merge_file();
+}
+
+
+bool hook_memo::fresh(uint64_t key, std::chrono::seconds ttl) const {
+	auto it = this->entries.find(key);
+	if (it == this->entries.end()) {
+		return false;
+	}
+	if (ttl.count() == 0) {
+		return true;
+	}
+	return now() - it->second.when < ttl.count();
+}
+
+
+void hook_memo::record(uint64_t key, std::chrono::seconds ttl) {
+	this->entries[key] = {now(), ttl.count()};
+	this->store();
+}
+
+
+int64_t hook_memo::now() {
+	return std::chrono::duration_cast<std::chrono::seconds>(
+		clock::now().time_since_epoch()).count();
+}
+
+
+void hook_memo::merge_file() {
+	std::ifstream file{this->path};
+	for (std::string line; std::getline(file, line);) {
+		std::istringstream fields{line};
+		uint64_t key;
+		entry read;
+		if (not (fields >> std::hex >> key >> std::dec >> read.when)) {
+			continue;
+		}
+		// older files have no ttl, those records stay
+		fields >> read.ttl;
+		entry &known = this->entries[key];
+		if (read.when > known.when) {
+			known = read;
+		}
+	}
+
+	int64_t current = now();
+	std::erase_if(this->entries, [&](auto &item) {
+		auto &[when, ttl] = item.second;
+		return ttl > 0 and current - when >= ttl;
+	});
+}
+
+
+void hook_memo::store() {
+	if (this->path.empty()) {
+		return;
+	}
+
+	std::error_code err;
+	std::filesystem::create_directories(std::filesystem::path{this->path}.parent_path(), err);
+
+	// other instances may have written it since, they wait for each other
+	int lockfd = open((this->path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (lockfd != -1) {
+		flock(lockfd, LOCK_EX);
+	}
+	this->merge_file();
+
+	std::string tmppath = std::format("{}.{}.tmp", this->path, getpid());
+	std::ofstream file{tmppath, std::ios::trunc};
+	for (auto &[key, entry] : this->entries) {
+		file << std::hex << key << " " << std::dec << entry.when << " " << entry.ttl << "\n";
+	}
+	file.close();
+	if (file) {
+		std::filesystem::rename(tmppath, this->path, err);
+	}
+	else {
+		log_error() << "failed to write hook memo " << tmppath;
+		std::filesystem::remove(tmppath, err);
+	}
+
+	// unlocks
+	if (lockfd != -1) {
+		close(lockfd);
+	}
+}
+
+
+void ring_buffer::write(const char *buf, size_t len) {
+	size_t capacity = this->data.size();
+	if (len >= capacity) {
+		this->dropped_bytes += this->used + len - capacity;
+		std::memcpy(this->data.data(), buf + len - capacity, capacity);
+		this->start = 0;
+		this->used = capacity;
+		return;
+	}
+
+	if (this->used + len > capacity) {
+		size_t overflow = this->used + len - capacity;
+		this->dropped_bytes += overflow;
+		this->start = (this->start + overflow) % capacity;
+		this->used -= overflow;
+	}
+
+	size_t end = (this->start + this->used) % capacity;
+	size_t first = std::min(len, capacity - end);
+	std::memcpy(this->data.data() + end, buf, first);
+	std::memcpy(this->data.data(), buf + first, len - first);
+	this->used += len;
+}
+
+
+std::string ring_buffer::str() const {
+	std::string ret;
+	ret.reserve(this->used);
+	size_t first = std::min(this->used, this->data.size() - this->start);
+	ret.append(this->data.data() + this->start, first);
+	ret.append(this->data.data(), this->used - first);
+	return ret;
+}
+
+
+void hook_runner::set_limits(const struct config::hooks &limits) {
+	this->jobs = std::max<size_t>(limits.jobs, 1);
+	this->queue_max = std::max<size_t>(limits.queue, 1);
+	this->shed_mode = limits.shed;
+	while (this->pending.size() > this->queue_max) {
+		this->shed(this->shed_mode == shed_policy::oldest
+		           ? this->pending.begin() : std::prev(this->pending.end()));
+	}
+	this->start_next();
+}
+
+
+void hook_runner::run(std::string label, std::string command, environment env,
+                      std::chrono::seconds timeout, callback on_done) {
+	std::vector<job> group;
+	group.push_back({std::move(label), std::move(command), std::move(env),
+	                 timeout, std::move(on_done), {}});
+	this->run_group(std::move(group));
+}
+
+
+void hook_runner::run_group(std::vector<job> group, uint32_t device) {
+	if (group.empty()) {
+		return;
+	}
+
+	if (device != 0) {
+		this->collapsed += std::erase_if(this->pending, [&](auto &waiting) {
+			return waiting.device == device;
+		});
+	}
+
+	if (this->pending.size() >= this->queue_max) {
+		if (this->shed_mode == shed_policy::newest) {
+			log_error() << "hook queue full, shedding [" << group.front().label << "]";
+			this->shed_count += 1;
+			return;
+		}
+		this->shed(this->pending.begin());
+	}
+
+	this->pending.push_back({device, std::move(group)});
+	this->start_next();
+}
+
+
+std::vector<int> hook_runner::fds() const {
+	std::vector<int> ret;
+	for (auto &hook : this->current) {
+		if (hook.state != hook_state::running) {
+			continue;
+		}
+		for (int fd : {hook.fd, hook.pidfd}) {
+			if (fd != -1) {
+				ret.push_back(fd);
+			}
+		}
+	}
+	return ret;
+}
+
+
+void hook_runner::read_output() {
+	for (auto &hook : this->current) {
+		if (hook.state == hook_state::running) {
+			this->read_output(hook);
+		}
+	}
+}
+
+
+void hook_runner::reap() {
+	for (size_t idx = 0; idx < this->current.size(); idx++) {
+		hook &hook = this->current[idx];
+		int status;
+		if (hook.state == hook_state::running and waitpid(hook.pid, &status, WNOHANG) > 0) {
+			this->read_output(hook);
+			this->finish(idx, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+		}
+	}
+	this->start_next();
+}
+
+
+void hook_runner::print_status(std::ostream &out) const {
+	size_t pending = std::ranges::count(this->current, hook_state::waiting, &hook::state);
+	for (auto &group : this->pending) {
+		pending += group.jobs.size();
+	}
+	out << "hooks: " << pending << " pending in " << this->pending.size()
+	    << "/" << this->queue_max << " queued events, "
+	    << this->collapsed << " collapsed, " << this->shed_count << " shed" << std::endl;
+	for (auto &hook : this->current) {
+		if (hook.state == hook_state::running) {
+			out << "running [" << hook.label << "] pid=" << hook.pid
+			    << ": '" << hook.command << "'" << std::endl;
+			print_output(out, hook);
+		}
+	}
+	for (auto &hook : this->failed) {
+		out << "failed [" << hook.label << "] with " << hook.result
+		    << ": '" << hook.command << "'" << std::endl;
+		print_output(out, hook);
+	}
+}
+
+
+void hook_runner::print_output(std::ostream &out, const hook &hook) {
+	std::string output = hook.output.str();
+	if (hook.output.dropped()) {
+		out << "[" << hook.label << "] ... " << hook.output.dropped()
+		    << " bytes dropped" << std::endl;
+	}
+
+	std::istringstream lines{output};
+	for (std::string line; std::getline(lines, line);) {
+		out << "[" << hook.label << "] " << line << std::endl;
+	}
+}
+
+
+void hook_runner::log_output(log_level level, const hook &hook) {
+	std::ostringstream out;
+	print_output(out, hook);
+	std::istringstream lines{std::move(out).str()};
+	for (std::string line; std::getline(lines, line);) {
+		log_message{level} << line;
+	}
+}
+
+
+void hook_runner::read_output(hook &hook) {
+	if (hook.fd == -1) {
+		return;
+	}
+
+	char buf[4096];
+	while (true) {
+		ssize_t len = read(hook.fd, buf, sizeof(buf));
+		if (len > 0) {
+			hook.output.write(buf, len);
+			continue;
+		}
+		if (len == -1 and errno == EINTR) {
+			continue;
+		}
+		if (len == 0) {
+			// closed by the hook and all its children
+			close(hook.fd);
+			hook.fd = -1;
+			this->generation += 1;
+		}
+		break;
+	}
+}
+
+
+void hook_runner::shed(std::deque<group>::iterator it) {
+	log_error() << "hook queue full, shedding [" << it->jobs.front().label << "]";
+	this->pending.erase(it);
+	this->shed_count += 1;
+}
+
+
+bool hook_runner::ready(const hook &hook) const {
+	return std::ranges::all_of(hook.after, [&](size_t idx) {
+		return idx >= this->current.size() or this->current[idx].state == hook_state::done;
+	});
+}
+
+
+void hook_runner::start_next() {
+	while (true) {
+		if (std::ranges::all_of(this->current, [](auto &hook) {
+			return hook.state == hook_state::done;
+		})) {
+			this->current.clear();
+			if (this->pending.empty()) {
+				return;
+			}
+			for (job &job : this->pending.front().jobs) {
+				this->current.push_back(hook{std::move(job)});
+			}
+			this->pending.pop_front();
+		}
+
+		bool progress = false;
+		for (size_t idx = 0; idx < this->current.size() and this->running < this->jobs; idx++) {
+			if (this->current[idx].state != hook_state::waiting or not this->ready(this->current[idx])) {
+				continue;
+			}
+			if (not this->spawn(idx)) {
+				this->finish(idx, -1);
+			}
+			progress = true;
+		}
+		if (progress) {
+			// finished hooks may have made others ready
+			continue;
+		}
+
+		if (this->running == 0) {
+			// the config is checked for this, but better not hang forever
+			for (size_t idx = 0; idx < this->current.size(); idx++) {
+				if (this->current[idx].state == hook_state::waiting) {
+					log_error() << "hook [" << this->current[idx].label
+					            << "] comes after itself, skipping it";
+					this->finish(idx, -1);
+					progress = true;
+				}
+			}
+		}
+		if (not progress) {
+			return;
+		}
+	}
+}
+
+
+bool hook_runner::spawn(size_t idx) {
+	hook &hook = this->current[idx];
+
+	int pipefd[2];
+	if (pipe2(pipefd, O_CLOEXEC) == -1) {
+		log_error() << "failed to create pipe for hook: " << std::strerror(errno);
+		return false;
+	}
+
+	hook.pid = fork();
+	if (hook.pid == -1) {
+		// failed to fork
+		log_error() << "failed to fork for command " << hook.command;
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return false;
+	}
+	else if (hook.pid == 0) {
+		// in child process
+		// own process group, so a timeout reaches everything it started
+		setpgid(0, 0);
+
+		dup2(pipefd[1], STDOUT_FILENO);
+		dup2(pipefd[1], STDERR_FILENO);
+
+		// the program may block signals it reads through signalfd
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+		// add new environment entries
+		for (auto &&entry : hook.env) {
+			setenv(entry.first.c_str(), entry.second.c_str(), true);
+		}
+
+		execlp("/bin/sh", "sh", "-c", hook.command.c_str(), nullptr);
+		perror("failed to execute script");
+		_exit(127);
+	}
+
+	// in parent process
+	// also set here, the child may not have done it yet when we signal it
+	setpgid(hook.pid, hook.pid);
+	close(pipefd[1]);
+	fcntl(pipefd[0], F_SETFL, fcntl(pipefd[0], F_GETFL) | O_NONBLOCK);
+	hook.state = hook_state::running;
+	this->running += 1;
+	hook.fd = pipefd[0];
+	hook.pidfd = syscall(SYS_pidfd_open, hook.pid, 0);
+	if (hook.pidfd != -1) {
+		fcntl(hook.pidfd, F_SETFD, FD_CLOEXEC);
+	}
+	else {
+		this->poll_exit(idx);
+	}
+	this->generation += 1;
+
+	if (hook.timeout.count() > 0) {
+		hook.timeout_timer = this->timers->add(hook.timeout, [this, idx] {
+			this->terminate(idx, SIGTERM);
+		});
+	}
+	return true;
+}
+
+
+void hook_runner::poll_exit(size_t idx) {
+	pid_t pid = this->current[idx].pid;
+	this->current[idx].reap_timer = this->timers->add(reap_interval, [this, idx, pid] {
+		this->reap();
+		// reaping may have moved on to the next group
+		if (idx < this->current.size() and this->current[idx].pid == pid
+		    and this->current[idx].state == hook_state::running) {
+			this->poll_exit(idx);
+		}
+	});
+}
+
+
+void hook_runner::terminate(size_t idx, int signal) {
+	hook &hook = this->current[idx];
+	log_error() << "hook [" << hook.label << "] timed out after " << hook.timeout.count()
+	            << "s, " << (signal == SIGKILL ? "killing" : "terminating") << " it";
+	kill(-hook.pid, signal);
+
+	if (signal == SIGTERM) {
+		hook.timeout_timer = this->timers->add(kill_delay, [this, idx] {
+			this->terminate(idx, SIGKILL);
+		});
+	}
+}
+
+
+void hook_runner::finish(size_t idx, int result) {
+	hook &hook = this->current[idx];
+	if (hook.state == hook_state::running) {
+		this->running -= 1;
+	}
+	hook.state = hook_state::done;
+	hook.result = result;
+	callback on_done = std::move(hook.on_done);
+	this->timers->cancel(hook.timeout_timer);
+	this->timers->cancel(hook.reap_timer);
+	if (hook.fd != -1) {
+		// children of the hook may still hold the pipe, we don't wait for them
+		close(hook.fd);
+		hook.fd = -1;
+	}
+	if (hook.pidfd != -1) {
+		close(hook.pidfd);
+		hook.pidfd = -1;
+	}
+	this->generation += 1;
+
+	if (result != 0) {
+		log_error() << "script failed: [" << hook.label << "] '" << hook.command
+		            << "' exited with " << result;
+		log_output(log_level::error, hook);
+
+		// what stays behind is done, that's all the group needs
+		this->failed.push_back(std::move(hook));
+		if (this->failed.size() > failed_max) {
+			this->failed.pop_front();
+		}
+	}
+	else {
+		log_output(log_level::info, hook);
+	}
+
+	if (on_done) {
+		on_done(result);
+	}
+}
+
+} // namespace xautocfg
@@ -0,0 +1,271 @@
+/**
+ * running hook commands in the background.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#include "config.h"
+#include "log.h"
+#include "timers.h"
+#include "util.h"
+
+
+namespace xautocfg {
+
+/**
+ * when memoized hooks last succeeded, for each hook and device identity.
+ * kept in $XDG_STATE_HOME/xautocfg/memo so it survives restarts.
+ * every instance and process of the user shares the file,
+ * each merges its records into it.
+ */
+class hook_memo {
+public:
+	using clock = std::chrono::system_clock;
+
+	hook_memo();
+
+	static uint64_t key(const std::string &command, const std::string &identity) {
+		return fnv1a(identity, fnv1a(std::string_view{command.c_str(), command.size() + 1}));
+	}
+
+	bool fresh(uint64_t key, std::chrono::seconds ttl) const;
+
+	/**
+	 * the ttl it was recorded with says when it can be dropped, 0 never.
+	 */
+	void record(uint64_t key, std::chrono::seconds ttl);
+
+private:
+	static int64_t now();
+
+	/**
+	 * records of the file, the newer one of each key is kept.
+	 * expired ones are dropped, so the file doesn't grow with every device.
+	 */
+	void merge_file();
+
+	void store();
+
+	struct entry {
+		int64_t when = 0;
+		int64_t ttl = 0;
+	};
+
+	std::string path;
+	std::unordered_map<uint64_t, entry> entries;
+};
+
+
+/**
+ * keeps the last bytes written to it, and counts what was dropped.
+ */
+class ring_buffer {
+public:
+	explicit ring_buffer(size_t capacity)
+		:
+		data(capacity) {}
+
+	void write(const char *buf, size_t len);
+
+	std::string str() const;
+
+	size_t dropped() const {
+		return this->dropped_bytes;
+	}
+
+private:
+	std::vector<char> data;
+	size_t start = 0;
+	size_t used = 0;
+	size_t dropped_bytes = 0;
+};
+
+
+/**
+ * runs hook commands without blocking the daemon.
+ *
+ * hooks are queued in groups, the hooks of one event.
+ * groups run one after another, so the hooks of a disconnect are done
+ * before those of the following connect start.
+ * within a group, a hook starts as soon as the hooks it comes after
+ * have finished, up to the process limit.
+ * a group then takes as long as its longest chain of hooks.
+ *
+ * the queue of waiting groups is bounded, so a flood of hotplug events
+ * can't pile up work without end.
+ * a new group for a device replaces those still waiting for it,
+ * only its latest state matters. devices are told apart by their
+ * generation in the device table, not by their id, which the server
+ * gives to the next device right away. when the queue is full,
+ * the oldest or the new group is shed, as configured.
+ *
+ * stdout and stderr of a hook go to a non-blocking pipe which is
+ * read from the event loop into a bounded buffer,
+ * so a chatty hook never stalls, its excess output is dropped.
+ *
+ * the exit of a hook is noticed through a pidfd, so no SIGCHLD handling
+ * is needed and children of the host program are never reaped.
+ * on kernels without pidfds, a timer polls for it.
+ */
+class hook_runner {
+public:
+	// how long a terminated hook gets before it's killed
+	static constexpr std::chrono::seconds kill_delay{5};
+	// how often to check for the exit of a hook without pidfd
+	static constexpr std::chrono::milliseconds reap_interval{100};
+
+	// how much output of each hook is kept
+	static constexpr size_t output_max = 4096;
+	// how many failed hooks are remembered for the status report
+	static constexpr size_t failed_max = 8;
+
+	using environment = std::unordered_map<std::string, std::string>;
+	using callback = std::function<void(int result)>;
+
+	/**
+	 * a shell command to run.
+	 * label identifies the hook in the logs.
+	 * it's terminated if it runs longer than timeout, unless that is 0.
+	 * on_done is called with the exit status once it has finished.
+	 */
+	struct job {
+		std::string label;
+		std::string command;
+		environment env;
+		std::chrono::seconds timeout{0};
+		callback on_done;
+		// indices of the jobs in the same group that have to finish first.
+		// they only order, a failed hook doesn't stop the ones after it.
+		std::vector<size_t> after;
+	};
+
+	explicit hook_runner(timer_wheel *timers)
+		:
+		timers{timers} {}
+
+	void set_limits(const struct config::hooks &limits);
+
+	/**
+	 * queue a single shell command.
+	 */
+	void run(std::string label, std::string command, environment env,
+	         std::chrono::seconds timeout, callback on_done = {});
+
+	/**
+	 * queue the hooks of one event.
+	 * device is the generation of the device whose state they follow, 0 for none.
+	 */
+	void run_group(std::vector<job> group, uint32_t device = 0);
+
+	/**
+	 * file descriptors of the running hooks to poll for reading:
+	 * their output pipes and pidfds, if they are open.
+	 */
+	std::vector<int> fds() const;
+
+	/**
+	 * changes whenever the result of fds() does.
+	 * closed fds can be reused by new hooks with the same number.
+	 */
+	uint64_t fds_generation() const {
+		return this->generation;
+	}
+
+	/**
+	 * read what's in the pipes of the running hooks.
+	 */
+	void read_output();
+
+	/**
+	 * collect the running hooks that have exited,
+	 * call when a pidfd is readable.
+	 */
+	void reap();
+
+	void print_status(std::ostream &out) const;
+
+private:
+	enum class hook_state {
+		waiting,
+		running,
+		done,
+	};
+
+	struct group {
+		uint32_t device;
+		std::vector<job> jobs;
+	};
+
+	struct hook : job {
+		hook_state state = hook_state::waiting;
+		timer_wheel::handle timeout_timer{};
+		timer_wheel::handle reap_timer{};
+		pid_t pid = -1;
+		int pidfd = -1;
+		int fd = -1;
+		ring_buffer output{output_max};
+		int result = 0;
+	};
+
+	static void print_output(std::ostream &out, const hook &hook);
+
+	/**
+	 * the kept output of a hook, one message per line.
+	 */
+	static void log_output(log_level level, const hook &hook);
+
+	void read_output(hook &hook);
+
+	void shed(std::deque<group>::iterator it);
+
+	bool ready(const hook &hook) const;
+
+	/**
+	 * start what can run: ready hooks of the current group,
+	 * or the next group once the current one is done.
+	 */
+	void start_next();
+
+	bool spawn(size_t idx);
+
+	void poll_exit(size_t idx);
+
+	/**
+	 * signal the process group of a running hook, it timed out.
+	 */
+	void terminate(size_t idx, int signal);
+
+	void finish(size_t idx, int result);
+
+	timer_wheel *timers;
+	size_t jobs = 1;
+	size_t queue_max = SIZE_MAX;
+	shed_policy shed_mode = shed_policy::oldest;
+	std::deque<group> pending;
+	// waiting groups replaced by a newer one for the same device
+	uint64_t collapsed = 0;
+	// groups dropped because the queue was full
+	uint64_t shed_count = 0;
+	// the group that is running
+	std::vector<hook> current;
+	size_t running = 0;
+	std::deque<hook> failed;
+	uint64_t generation = 0;
+};
+
+} // namespace xautocfg
@@ -0,0 +1,866 @@
+/**
+ * libxautocfg: apply an xautocfg config to an X display
+ * from within another program.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "xautocfg.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <X11/XKBlib.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XI2.h>
+#include <X11/extensions/XInput2.h>
+
+#include "color.h"
+#include "devices.h"
+#include "dpi.h"
+#include "focus.h"
+#include "hooks.h"
+#include "keyboard.h"
+#include "keyboard_settings.h"
+#include "log.h"
+#include "quirks.h"
+#include "resources.h"
+#include "session.h"
+#include "sleep.h"
+#include "timers.h"
+
+
+namespace xautocfg {
+
+/**
+ * log x errors instead of exiting.
+ * devices and windows may be gone before our requests for them arrive.
+ */
+int handle_x_error(Display *display, XErrorEvent *error) {
+	char text[256];
+	XGetErrorText(display, error->error_code, text, sizeof(text));
+	log_error() << "x error: " << text
+	            << " (request " << static_cast<int>(error->request_code)
+	            << "." << static_cast<int>(error->minor_code) << ")";
+	return 0;
+}
+
+
+Display *open_display(const char *name) {
+	log_info() << "connecting to x...";
+
+	Display *display = XOpenDisplay(name);
+	if (not display) {
+		throw std::runtime_error{std::format("failed to connect to x display '{}'",
+		                                     XDisplayName(name))};
+	}
+	return display;
+}
+
+
+struct instance::state {
+	state(std::shared_ptr<config_source> source, const options &opts)
+		:
+		source{std::move(source)},
+		cfg{this->source->current()},
+		watch{opts.watch},
+		display{open_display(opts.display)},
+		devices{this->display} {
+
+		// closed again if anything below throws, the destructor doesn't run then
+		std::unique_ptr<Display, decltype(&XCloseDisplay)> display_guard{this->display, XCloseDisplay};
+
+		if (opts.log_x_errors) {
+			XSetErrorHandler(handle_x_error);
+		}
+
+		// what we have set on this connection.
+		// on a new connection to a restarted server, everything is sent again.
+		this->cfg->session.apply(this->display, &this->applied_session);
+		XFlush(this->display);
+
+		int firstevent, error;
+		if (!XQueryExtension(this->display, "XInputExtension", &this->xi_opcode, &firstevent, &error)) {
+			throw std::runtime_error{"no xinput extension"};
+		}
+
+		int xkb_major = XkbMajorVersion, xkb_minor = XkbMinorVersion;
+		if (!XkbQueryExtension(this->display, &this->xkb_opcode, &this->xkb_event, &error, &xkb_major, &xkb_minor)) {
+			throw std::runtime_error{"no xkb extension"};
+		}
+
+		this->setup_locks();
+		this->hooks.set_limits(this->cfg->hooks);
+
+		if (this->cfg->resources.dpi) {
+			this->track_dpi();
+		}
+		merge_resources(this->display, this->cfg->resources, this->derived_resources());
+
+		if (this->cfg->color.enabled) {
+			this->color.emplace(this->display, &this->timers, this->watch, this->cfg->color);
+		}
+
+		if (not this->cfg->quirks_db.empty()) {
+			this->quirks.open(this->cfg->quirks_db);
+		}
+
+		// select before listing the devices, so we don't miss any
+		if (opts.watch) {
+			XIEventMask mask;
+			mask.deviceid = XIAllDevices;
+			mask.mask_len = XIMaskLen(XI_HierarchyChanged);
+			auto maskdata = std::make_unique<unsigned char[]>(mask.mask_len);
+			mask.mask = maskdata.get();
+			XISetMask(mask.mask, XI_HierarchyChanged);
+			XISelectEvents(this->display, DefaultRootWindow(this->display), &mask, 1);
+		}
+
+		this->devices.load();
+
+		// set rate at startup for each master keyboard, the server passes it on to their slaves.
+		// usually there's only the core keyboard, but there can be more with multi-pointer X.
+		log_info() << "setting rate to master keyboards...";
+		this->devices.for_each(XIMasterKeyboard, [&](int deviceid) {
+			set_kbd_controls(this->display, this->xkb_opcode, deviceid, this->keyboard_cfg(deviceid));
+		});
+
+		// per-device settings have to go to each present keyboard
+		if (this->cfg->per_device()) {
+			this->devices.for_each(XISlaveKeyboard, [&](int deviceid) {
+				this->apply_kbd_settings(deviceid, true);
+			});
+		}
+
+		if (opts.watch and not this->cfg->app_profiles.empty()) {
+			this->track_focus();
+		}
+
+		XFlush(this->display);
+
+		this->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (this->epfd == -1) {
+			throw std::runtime_error{"failed to create epoll fd"};
+		}
+		this->reload_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (this->reload_fd == -1) {
+			close(this->epfd);
+			throw std::runtime_error{"failed to create eventfd"};
+		}
+		this->source->add_listener(this->reload_fd);
+		if (this->source->current() != this->cfg) {
+			// published while we were setting up
+			eventfd_write(this->reload_fd, 1);
+		}
+
+		if (opts.watch) {
+			this->sleep.emplace([this](bool sleeping) {
+				this->prepare_for_sleep(sleeping);
+			});
+		}
+
+		for (int fd : {ConnectionNumber(this->display), this->timers.fd(), this->reload_fd,
+		               this->sleep ? this->sleep->fd() : -1}) {
+			if (fd == -1) {
+				continue;
+			}
+			epoll_event ev{};
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev);
+		}
+
+		// from now on, the destructor closes it
+		display_guard.release();
+	}
+
+	~state() {
+		this->source->remove_listener(this->reload_fd);
+		close(this->reload_fd);
+		close(this->epfd);
+		// the gamma ramps would stay as we set them
+		if (this->color) {
+			this->color->restore();
+		}
+		XCloseDisplay(this->display);
+	}
+
+	// lock state of the core keyboard, only needed to sync new keyboards
+	void setup_locks() {
+		auto any_keyboard = [&](auto &&pred) {
+			return pred(this->cfg->keyboard)
+			       or std::ranges::any_of(this->cfg->device_rules, [&](auto &rule) {
+				return pred(rule.keyboard);
+			});
+		};
+
+		if (any_keyboard([](auto &kbd) { return kbd.numlock != lock_mode::keep; })) {
+			this->locks.numlock_mask = XkbKeysymToModifiers(this->display, XK_Num_Lock);
+		}
+		if (any_keyboard([](auto &kbd) {
+			return kbd.capslock == lock_mode::sync or kbd.numlock == lock_mode::sync;
+		})) {
+			XkbStateRec state;
+			if (XkbGetState(this->display, XkbUseCoreKbd, &state) == Success) {
+				this->locks.locked_mods = state.locked_mods;
+			}
+			XkbSelectEventDetails(this->display, XkbUseCoreKbd, XkbStateNotify,
+			                      XkbModifierLockMask, XkbModifierLockMask);
+		}
+	}
+
+	void track_dpi() {
+		this->dpi.emplace(this->display, &this->timers, this->watch, [this] {
+			update_resources(this->display, this->derived_resources());
+		});
+	}
+
+	/**
+	 * resources that follow the monitors.
+	 */
+	resource_db derived_resources() const {
+		if (not this->dpi) {
+			return {};
+		}
+		return this->dpi->resources(this->cfg->resources);
+	}
+
+	const struct config::keyboard &rule_cfg(int deviceid) {
+		if (this->cfg->device_rules.empty()) {
+			return this->cfg->keyboard;
+		}
+		// a copy, looking up the master may grow the table
+		std::string name = this->devices.name(deviceid);
+		return this->cfg->keyboard_for(name, this->devices.master_name(deviceid));
+	}
+
+	const struct config::keyboard &keyboard_cfg(int deviceid) {
+		const struct config::keyboard &kbd = this->rule_cfg(deviceid);
+		if (not this->quirks.is_open() or this->devices.get(deviceid).use != XISlaveKeyboard) {
+			return kbd;
+		}
+
+		auto &meta = this->devices.meta(deviceid);
+		if (not meta.quirks_checked) {
+			meta.quirks_checked = true;
+			auto [vendor, product] = this->devices.product_id(deviceid);
+			if (auto entries = this->quirks.lookup(vendor, product)) {
+				log_info() << "applying quirks for " << std::format("{:04x}:{:04x}", vendor, product)
+				           << " to device=" << deviceid;
+				auto quirk_kbd = std::make_unique<struct config::keyboard>(kbd);
+				quirk_db::apply(*entries, quirk_kbd.get());
+				meta.quirk_kbd = std::move(quirk_kbd);
+			}
+		}
+		return meta.quirk_kbd ? *meta.quirk_kbd : kbd;
+	}
+
+	void apply_kbd_settings(int deviceid, bool enabled) {
+		if (enabled) {
+			auto &kbd = this->keyboard_cfg(deviceid);
+
+			// only if the device hasn't got them yet, they are sent
+			// in the same flush as the controls.
+			this->devices.meta(deviceid).keymap.apply(this->display, deviceid, kbd.remaps);
+
+			// we could use XkbUseCoreKbd as deviceid to always target the core
+			log_info() << "setting repeat rate on device=" << deviceid;
+			set_kbd_controls(this->display, this->xkb_opcode, deviceid, kbd);
+			if (this->profile) {
+				// plugged in while an application profile is active
+				XkbSetAutoRepeatRate(this->display, deviceid, this->profile->delay, this->profile->interval);
+			}
+			this->locks.apply(this->display, deviceid, kbd);
+			this->devices.get(deviceid).applied = &kbd;
+		}
+	}
+
+	void track_focus() {
+		this->focus.emplace(this->display, this->cfg.get(), [this](const config::app_profile *profile) {
+			this->switch_profile(profile);
+		});
+	}
+
+	/**
+	 * give every keyboard the rate of the focused application's profile,
+	 * or its own one again without a profile.
+	 */
+	void switch_profile(const config::app_profile *profile) {
+		this->profile = profile;
+		auto set_rate = [&](int deviceid) {
+			if (profile) {
+				XkbSetAutoRepeatRate(this->display, deviceid, profile->delay, profile->interval);
+			}
+			else {
+				auto &kbd = this->keyboard_cfg(deviceid);
+				XkbSetAutoRepeatRate(this->display, deviceid, kbd.delay, kbd.interval);
+			}
+		};
+		this->devices.for_each(XIMasterKeyboard, set_rate);
+		this->devices.for_each(XISlaveKeyboard, set_rate);
+		XFlush(this->display);
+	}
+
+	/**
+	 * only what the command uses, everything comes from the device table.
+	 */
+	hook_runner::environment hook_env(int deviceid, const struct config::keyboard &kbd,
+	                                  const hook_command &hook) {
+		hook_runner::environment env{{"XINPUTID", std::format("{}", deviceid)}};
+		if (hook.vars & hook_var_name) {
+			env["XINPUTNAME"] = this->devices.name(deviceid);
+		}
+		if (hook.vars & (hook_var_vendor | hook_var_product)) {
+			auto [vendor, product] = this->devices.product_id(deviceid);
+			env["XINPUTVENDOR"] = std::format("{:04x}", vendor);
+			env["XINPUTPRODUCT"] = std::format("{:04x}", product);
+		}
+		if (hook.vars & hook_var_node) {
+			env["XINPUTNODE"] = this->devices.node(deviceid);
+		}
+		if (hook.vars & hook_var_master) {
+			env["XINPUTMASTER"] = std::format("{}", this->devices.get(deviceid).attachment);
+		}
+		if (hook.vars & hook_var_rule) {
+			env["XAUTOCFG_RULE"] = kbd.rule;
+		}
+		return env;
+	}
+
+	/**
+	 * the hooks for a keyboard event, memoized ones are left out.
+	 */
+	std::vector<hook_runner::job> plug_jobs(int deviceid, bool enabled) {
+		auto &kbd = this->keyboard_cfg(deviceid);
+		auto &event_hooks = enabled ? kbd.on_connect : kbd.on_disconnect;
+		std::string_view event = enabled ? "on_connect" : "on_disconnect";
+
+		std::vector<hook_runner::job> group;
+		// the hook of each job, for resolving what they come after
+		std::vector<const hook_command *> group_hooks;
+
+		for (auto &hook : event_hooks.hooks) {
+			if (hook.command.empty()) {
+				continue;
+			}
+
+			std::string label = hook.name.empty()
+			                    ? std::format("{} device={}", event, deviceid)
+			                    : std::format("{}.{} device={}", event, hook.name, deviceid);
+			hook_runner::callback on_done;
+
+			if (event_hooks.memoize.enabled) {
+				uint64_t key = hook_memo::key(hook.command, this->devices.identity(deviceid));
+				if (this->memo.fresh(key, event_hooks.memoize.ttl)) {
+					// hooks after it don't wait for it
+					log_info() << "skipping memoized hook [" << label << "]";
+					continue;
+				}
+				on_done = [this, key, ttl = event_hooks.memoize.ttl](int result) {
+					if (result == 0) {
+						this->memo.record(key, ttl);
+					}
+				};
+			}
+
+			group.push_back({std::move(label), hook.command, this->hook_env(deviceid, kbd, hook),
+			                 kbd.hook_timeout, std::move(on_done), {}});
+			group_hooks.push_back(&hook);
+		}
+
+		for (size_t idx = 0; idx < group.size(); idx++) {
+			for (auto &name : group_hooks[idx]->after) {
+				auto it = std::ranges::find(group_hooks, name, &hook_command::name);
+				if (it != group_hooks.end()) {
+					group[idx].after.push_back(it - group_hooks.begin());
+				}
+			}
+		}
+		return group;
+	}
+
+	void run_kbd_plug_script(int deviceid, bool enabled) {
+		this->hooks.run_group(this->plug_jobs(deviceid, enabled), this->devices.get(deviceid).generation);
+	}
+
+	void handle_keyboard_plug(int deviceid, bool enabled) {
+		this->apply_kbd_settings(deviceid, enabled);
+		this->run_kbd_plug_script(deviceid, enabled);
+	}
+
+	void handle_hierarchy(const XIHierarchyEvent &hev) {
+		for (ssize_t i = 0; i < hev.num_info; i++) {
+			const XIHierarchyInfo *hier = &hev.info[i];
+			if (not hier->flags) {
+				continue;
+			}
+
+			// removed devices stay in the table until their disconnect hook has been set up
+			bool removed = hier->flags & (XIMasterRemoved | XISlaveRemoved);
+			int old_attachment = 0;
+			if (not removed) {
+				old_attachment = this->devices.get(hier->deviceid).attachment;
+				this->devices.update(*hier);
+				if (hier->attachment != old_attachment) {
+					// quirks were applied on top of the old master's rule
+					auto &meta = this->devices.meta(hier->deviceid);
+					if (meta.quirk_kbd) {
+						this->devices.get(hier->deviceid).applied = nullptr;
+						meta.quirk_kbd.reset();
+					}
+					meta.quirks_checked = false;
+				}
+			}
+
+			if (hier->use == XISlaveKeyboard and this->resume.active) {
+				// reconciled once the resume is over, the disconnect
+				// hooks are prepared while the device is still known
+				if (hier->flags & XIDeviceDisabled) {
+					this->resume.gone.push_back({this->devices.identity(hier->deviceid),
+					                             this->devices.get(hier->deviceid).generation,
+					                             this->plug_jobs(hier->deviceid, false)});
+				}
+			}
+			else if (hier->use == XISlaveKeyboard) {
+				if (hier->flags & XIDeviceEnabled) {
+					this->handle_keyboard_plug(hier->deviceid, true);
+				}
+				else if (hier->enabled and not removed
+				         and (hier->flags & XISlaveAttached)
+				         and hier->attachment != old_attachment
+				         and not this->cfg->device_rules.empty()) {
+					// it now belongs to another master, which may have another profile
+					// only if a setting differs, profiles often just repeat [keyboard]
+					const struct config::keyboard *applied = this->devices.get(hier->deviceid).applied;
+					if (applied == nullptr
+					    or keyboard_settings::differs(*applied, this->keyboard_cfg(hier->deviceid))) {
+						log_info() << "device=" << hier->deviceid
+						           << " attached to master=" << hier->attachment;
+						this->apply_kbd_settings(hier->deviceid, true);
+					}
+				}
+				if (hier->flags & XIDeviceDisabled) {
+					this->handle_keyboard_plug(hier->deviceid, false);
+				}
+			}
+
+			if (removed) {
+				this->devices.update(*hier);
+			}
+		}
+
+		if (this->resume.resumed) {
+			this->extend_resume_window();
+		}
+	}
+
+	/**
+	 * from logind: before sleeping, and after resuming.
+	 * keyboards are disabled and enabled again around it, often all at once.
+	 * instead of handling each, the keyboard table is reconciled
+	 * once it has been quiet for a moment after the resume.
+	 */
+	void prepare_for_sleep(bool sleeping) {
+		if (sleeping) {
+			log_info() << "going to sleep, deferring keyboard changes";
+			this->timers.cancel(this->resume.quiet);
+			this->resume.active = true;
+			this->resume.resumed = false;
+			this->resume.before.clear();
+			this->resume.gone.clear();
+			this->devices.for_each(XISlaveKeyboard, [&](int deviceid) {
+				this->resume.before[this->devices.identity(deviceid)]++;
+			});
+
+			// the monotonic clock stands still while sleeping, so this only
+			// runs out when the resume signal was lost, e.g. logind restarted
+			this->resume.quiet = this->timers.add(resume_lost, [this] {
+				log_info() << "no resume signal after going to sleep, reconciling keyboards";
+				this->reconcile_after_resume();
+			});
+		}
+		else if (this->resume.active) {
+			log_info() << "resumed, waiting for keyboards to settle";
+			this->resume.resumed = true;
+			this->resume.deadline = std::chrono::steady_clock::now() + resume_max;
+			this->extend_resume_window();
+		}
+	}
+
+	void extend_resume_window() {
+		this->timers.cancel(this->resume.quiet);
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+			this->resume.deadline - std::chrono::steady_clock::now());
+		this->resume.quiet = this->timers.add(std::clamp(left, std::chrono::milliseconds{0}, resume_quiet),
+		                                      [this] {
+			this->reconcile_after_resume();
+		});
+	}
+
+	/**
+	 * one pass over the keyboards after a resume.
+	 * keyboards that were there before sleeping only get their settings again,
+	 * hooks run for the ones that are new or gone.
+	 */
+	void reconcile_after_resume() {
+		this->timers.cancel(this->resume.quiet);
+		this->resume.active = false;
+		this->resume.resumed = false;
+
+		size_t count = 0, connected = 0, disconnected = 0;
+		std::map<std::string, size_t> present;
+		this->devices.for_each(XISlaveKeyboard, [&](int deviceid) {
+			present[this->devices.identity(deviceid)]++;
+			count++;
+		});
+
+		// disconnect hooks first, a keyboard that was replaced by a new one
+		// gets its on_disconnect before the new one's on_connect
+		for (auto &gone : this->resume.gone) {
+			// only for as many as are missing of that kind,
+			// and not for keyboards that came and went while resuming
+			auto before = this->resume.before.find(gone.identity);
+			if (before != this->resume.before.end() and before->second > present[gone.identity]) {
+				before->second--;
+				this->hooks.run_group(std::move(gone.jobs), gone.generation);
+				disconnected++;
+			}
+		}
+
+		// identical keyboards can't be told apart,
+		// each one that was there before counts for one that is there now
+		this->devices.for_each(XISlaveKeyboard, [&](int deviceid) {
+			auto before = this->resume.before.find(this->devices.identity(deviceid));
+			if (before != this->resume.before.end() and before->second > 0) {
+				before->second--;
+				// remaps are only sent if they differ from what the device has
+				this->apply_kbd_settings(deviceid, true);
+			}
+			else {
+				this->handle_keyboard_plug(deviceid, true);
+				connected++;
+			}
+		});
+		this->resume.before.clear();
+		this->resume.gone.clear();
+
+		log_info() << "reconciled " << count << " keyboards after resume, "
+		           << connected << " connected, " << disconnected << " disconnected";
+	}
+
+	void handle_x_events() {
+		// handle everything xlib has already read
+		while (XPending(this->display)) {
+			XEvent event;
+			XNextEvent(this->display, &event);
+
+			if (this->focus and (event.type == PropertyNotify or event.type == DestroyNotify)) {
+				this->focus->handle_event(event);
+				continue;
+			}
+
+			// both follow the monitors
+			bool randr = this->dpi and this->dpi->handle_event(event);
+			randr = (this->color and this->color->handle_event(event)) or randr;
+			if (randr) {
+				continue;
+			}
+
+			if (event.type == this->xkb_event) {
+				XkbEvent *xkbev = reinterpret_cast<XkbEvent*>(&event);
+				if (xkbev->any.xkb_type == XkbStateNotify) {
+					this->locks.locked_mods = xkbev->state.locked_mods;
+				}
+				continue;
+			}
+
+			if (event.type == GenericEvent && event.xcookie.extension == this->xi_opcode) {
+				if (event.xcookie.evtype == XI_HierarchyChanged) {
+					if (!XGetEventData(this->display, &event.xcookie))
+						continue;
+
+					this->handle_hierarchy(*reinterpret_cast<XIHierarchyEvent*>(event.xcookie.data));
+
+					XFreeEventData(this->display, &event.xcookie);
+				}
+			}
+		}
+	}
+
+	/**
+	 * switch to the current snapshot of the source.
+	 * keyboards only get what differs from what they have.
+	 */
+	void reload() {
+		std::shared_ptr<const config> next = this->source->current();
+		if (next == this->cfg) {
+			return;
+		}
+		log_info() << "applying new config...";
+
+		// the devices, the focus tracker and the profile point into the old snapshot until they are updated
+		std::shared_ptr<const config> old = std::exchange(this->cfg, std::move(next));
+
+		// only sends what differs from what we have set
+		this->cfg->session.apply(this->display, &this->applied_session);
+		if (this->cfg->resources.dpi != old->resources.dpi) {
+			this->dpi.reset();
+			if (this->cfg->resources.dpi) {
+				this->track_dpi();
+			}
+		}
+		merge_resources(this->display, this->cfg->resources, this->derived_resources());
+		if (this->cfg->color.enabled) {
+			if (this->color) {
+				this->color->configure(this->cfg->color);
+			}
+			else {
+				this->color.emplace(this->display, &this->timers, this->watch, this->cfg->color);
+			}
+		}
+		else if (this->color) {
+			this->color->restore();
+			this->color.reset();
+		}
+		this->setup_locks();
+		this->hooks.set_limits(this->cfg->hooks);
+
+		// a rebuilt database is picked up too
+		this->quirks.close();
+		if (not this->cfg->quirks_db.empty()) {
+			this->quirks.open(this->cfg->quirks_db);
+		}
+
+		// what each keyboard has now, quirk settings are kept until compared
+		std::vector<std::pair<int, const struct config::keyboard *>> applied;
+		std::vector<std::unique_ptr<const struct config::keyboard>> old_quirks;
+		this->devices.for_each(XISlaveKeyboard, [&](int deviceid) {
+			applied.emplace_back(deviceid, this->devices.get(deviceid).applied);
+			auto &meta = this->devices.meta(deviceid);
+			if (meta.quirk_kbd) {
+				old_quirks.push_back(std::move(meta.quirk_kbd));
+			}
+			meta.quirks_checked = false;
+		});
+		this->devices.forget_applied();
+
+		// the focus tracker may have changed their rate
+		this->devices.for_each(XIMasterKeyboard, [&](int deviceid) {
+			set_kbd_controls(this->display, this->xkb_opcode, deviceid, this->keyboard_cfg(deviceid));
+		});
+
+		for (auto [deviceid, kbd] : applied) {
+			if (kbd == nullptr and not this->cfg->per_device()) {
+				// it still gets everything from its master
+				continue;
+			}
+			auto &next_kbd = this->keyboard_cfg(deviceid);
+			if (kbd == nullptr or keyboard_settings::differs(*kbd, next_kbd)) {
+				// the remaps are only sent again if they differ for this device,
+				// anything else would undo swaps
+				this->apply_kbd_settings(deviceid, true);
+			}
+			else {
+				this->devices.get(deviceid).applied = &next_kbd;
+			}
+		}
+
+		// the new tracker switches to the profile of the focused window right away
+		this->focus.reset();
+		if (this->watch and not this->cfg->app_profiles.empty()) {
+			this->track_focus();
+		}
+		else if (this->profile) {
+			this->switch_profile(nullptr);
+		}
+	}
+
+	/**
+	 * watch the fds of the running hook in the epoll set.
+	 */
+	void update_hook_fds() {
+		if (this->hooks.fds_generation() == this->hook_fds_generation) {
+			return;
+		}
+
+		// closed fds are already gone from the set, so errors are expected
+		for (int fd : this->hook_fds) {
+			epoll_ctl(this->epfd, EPOLL_CTL_DEL, fd, nullptr);
+		}
+
+		this->hook_fds = this->hooks.fds();
+		this->hook_fds_generation = this->hooks.fds_generation();
+		for (int fd : this->hook_fds) {
+			epoll_event ev{};
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev);
+		}
+	}
+
+	void dispatch() {
+		std::array<epoll_event, 4> events;
+		int count = epoll_wait(this->epfd, events.data(), events.size(), 0);
+		bool hook_ready = false;
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.fd == this->timers.fd()) {
+				this->timers.dispatch();
+			}
+			else if (events[i].data.fd == this->reload_fd) {
+				uint64_t published;
+				if (read(this->reload_fd, &published, sizeof(published)) == sizeof(published)) {
+					this->reload();
+				}
+			}
+			else if (this->sleep and events[i].data.fd == this->sleep->fd()) {
+				this->sleep->dispatch();
+			}
+			else if (events[i].data.fd != ConnectionNumber(this->display)) {
+				hook_ready = true;
+			}
+		}
+
+		if (hook_ready) {
+			this->hooks.read_output();
+			this->hooks.reap();
+		}
+
+		this->handle_x_events();
+
+		// event handling may have started new hooks
+		this->update_hook_fds();
+		XFlush(this->display);
+	}
+
+	std::shared_ptr<config_source> source;
+	// the snapshot everything is applied from, replaced by reload()
+	std::shared_ptr<const config> cfg;
+	bool watch;
+	Display *display;
+	int xi_opcode = 0;
+	int xkb_opcode = 0;
+	int xkb_event = 0;
+
+	session_settings applied_session;
+	lock_state locks;
+	device_table devices;
+	timer_wheel timers;
+	hook_runner hooks{&this->timers};
+	hook_memo memo;
+	std::optional<focus_tracker> focus;
+	// of the focused window, its rate goes to all keyboards
+	const config::app_profile *profile = nullptr;
+	std::optional<dpi_tracker> dpi;
+	std::optional<color_manager> color;
+	std::optional<sleep_monitor> sleep;
+
+	// a resume is over when keyboards have been quiet for this long, or at the latest after max
+	static constexpr std::chrono::milliseconds resume_quiet{1000};
+	static constexpr std::chrono::seconds resume_max{10};
+	// awake time after going to sleep without a resume signal
+	static constexpr std::chrono::minutes resume_lost{2};
+
+	struct resume_state {
+		// from going to sleep until the reconciliation
+		bool active = false;
+		// after resuming, the quiet timer runs
+		bool resumed = false;
+		std::chrono::steady_clock::time_point deadline;
+		timer_wheel::handle quiet;
+
+		// identities of the keyboards before sleeping, and how many of each
+		std::map<std::string, size_t> before;
+
+		struct gone_keyboard {
+			std::string identity;
+			uint32_t generation;
+			std::vector<hook_runner::job> jobs;
+		};
+		std::vector<gone_keyboard> gone;
+	} resume;
+
+	quirk_db quirks;
+
+	int epfd = -1;
+	int reload_fd = -1;
+	std::vector<int> hook_fds;
+	uint64_t hook_fds_generation = 0;
+};
+
+
+instance::instance(config cfg, const options &opts)
+	:
+	instance{std::make_shared<config_source>(std::move(cfg)), opts} {}
+
+
+instance::instance(config cfg)
+	:
+	instance{std::move(cfg), options{}} {}
+
+
+instance::instance(std::shared_ptr<config_source> source, const options &opts)
+	:
+	impl{std::make_unique<state>(std::move(source), opts)} {}
+
+
+instance::~instance() = default;
+
+
+int instance::fd() const {
+	return this->impl->epfd;
+}
+
+
+int instance::timeout() const {
+	// xlib may have read events already, they don't make the fd readable again
+	if (QLength(this->impl->display) > 0) {
+		return 0;
+	}
+	// everything else is on the epoll fd, timers too
+	return -1;
+}
+
+
+void instance::dispatch() {
+	this->impl->dispatch();
+}
+
+
+void instance::sync() {
+	XSync(this->impl->display, False);
+}
+
+
+void instance::print_status(std::ostream &out) const {
+	this->impl->hooks.print_status(out);
+}
+
+
+Display *instance::display() const {
+	return this->impl->display;
+}
+
+
+std::shared_ptr<const config> instance::get_config() const {
+	return this->impl->cfg;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,160 @@
+/**
+ * xkb settings of keyboards: controls, lock modifiers and remaps.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "keyboard.h"
+#include "keyboard_settings.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <X11/XKBlib.h>
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#include <X11/extensions/XKB.h>
+#include <X11/extensions/XKBproto.h>
+
+// Xlibint.h defines these as macros
+#undef min
+#undef max
+
+
+namespace xautocfg {
+
+void set_kbd_controls(Display *dpy, int xkb_opcode, int deviceid,
+                      const struct config::keyboard &kbd) {
+	xkbSetControlsReq values{};
+	values.deviceSpec = deviceid;
+	// the repeat rate is always sent, the rest only if configured
+	keyboard_settings::apply(kbd, &values);
+
+	LockDisplay(dpy);
+	xkbSetControlsReq *req;
+	GetReq(kbSetControls, req);
+	values.reqType = xkb_opcode;
+	values.xkbReqType = X_kbSetControls;
+	values.length = req->length;
+	std::memcpy(req, &values, sz_xkbSetControlsReq);
+	UnlockDisplay(dpy);
+	SyncHandle();
+}
+
+
+/**
+ * modifier bits a key producing this keysym should have,
+ * taken from a key that already produces it.
+ */
+unsigned char modmap_for_keysym(XkbDescPtr xkb, KeySym sym) {
+	for (int kc = xkb->min_key_code; kc <= xkb->max_key_code; kc++) {
+		if (XkbKeyNumSyms(xkb, kc) > 0 and XkbKeySymsPtr(xkb, kc)[0] == sym) {
+			return xkb->map->modmap[kc];
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * keysyms and modifiers of a key, with remaps applied.
+ * mods has the modifiers of each remap's target.
+ */
+void remap_key(XkbDescPtr xkb, int kc, const std::vector<remap> &remaps,
+               const std::vector<unsigned char> &mods,
+               std::vector<KeySym> *syms, unsigned char *modmap) {
+	KeySym *orig = XkbKeySymsPtr(xkb, kc);
+	syms->assign(orig, orig + XkbKeyNumSyms(xkb, kc));
+	*modmap = xkb->map->modmap[kc];
+
+	for (size_t i = 0; i < syms->size(); i++) {
+		for (size_t r = 0; r < remaps.size(); r++) {
+			if ((*syms)[i] != remaps[r].from) {
+				continue;
+			}
+			(*syms)[i] = remaps[r].to;
+			if (i == 0) {
+				*modmap = mods[r];
+			}
+			break;
+		}
+	}
+}
+
+
+void keymap_remap::xkb_free::operator ()(XkbDescPtr xkb) const {
+	XkbFreeKeyboard(xkb, 0, True);
+}
+
+
+void keymap_remap::apply(Display *display, int deviceid, const std::vector<remap> &remaps) {
+	if (remaps == this->applied) {
+		return;
+	}
+
+	if (not this->original) {
+		this->original.reset(XkbGetMap(display, XkbKeySymsMask | XkbModifierMapMask, deviceid));
+		if (not this->original) {
+			log_error() << "failed to get keymap of device=" << deviceid;
+			return;
+		}
+	}
+	XkbDescPtr xkb = this->original.get();
+
+	// all modifiers are taken from the original, so swaps work
+	auto target_mods = [&](const std::vector<remap> &rules) {
+		std::vector<unsigned char> ret;
+		ret.reserve(rules.size());
+		for (auto &rule : rules) {
+			ret.push_back(modmap_for_keysym(xkb, rule.to));
+		}
+		return ret;
+	};
+	std::vector<unsigned char> before_mods = target_mods(this->applied);
+	std::vector<unsigned char> after_mods = target_mods(remaps);
+
+	// the keys whose remapped state differs from what they got last
+	int first = xkb->max_key_code + 1;
+	int last = xkb->min_key_code - 1;
+	std::vector<KeySym> before, after;
+	unsigned char before_modmap, after_modmap;
+	for (int kc = xkb->min_key_code; kc <= xkb->max_key_code; kc++) {
+		remap_key(xkb, kc, this->applied, before_mods, &before, &before_modmap);
+		remap_key(xkb, kc, remaps, after_mods, &after, &after_modmap);
+		if (before != after or before_modmap != after_modmap) {
+			first = std::min(first, kc);
+			last = std::max(last, kc);
+		}
+	}
+	this->applied = remaps;
+
+	if (first > last) {
+		return;
+	}
+	log_info() << "remapping keys " << first << ".." << last << " on device=" << deviceid;
+
+	// the request is built from the keymap, which is put back afterwards
+	std::vector<KeySym> orig_syms{xkb->map->syms, xkb->map->syms + xkb->map->num_syms};
+	std::vector<unsigned char> orig_modmap{xkb->map->modmap, xkb->map->modmap + xkb->max_key_code + 1};
+	for (int kc = first; kc <= last; kc++) {
+		remap_key(xkb, kc, remaps, after_mods, &after, &after_modmap);
+		std::ranges::copy(after, XkbKeySymsPtr(xkb, kc));
+		xkb->map->modmap[kc] = after_modmap;
+	}
+
+	XkbMapChangesRec changes{};
+	changes.changed = XkbKeySymsMask | XkbModifierMapMask;
+	changes.first_key_sym = first;
+	changes.num_key_syms = last - first + 1;
+	changes.first_modmap_key = first;
+	changes.num_modmap_keys = last - first + 1;
+	XkbChangeMap(display, xkb, &changes);
+
+	std::ranges::copy(orig_syms, xkb->map->syms);
+	std::ranges::copy(orig_modmap, xkb->map->modmap);
+}
+
+} // namespace xautocfg
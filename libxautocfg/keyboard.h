@@ -0,0 +1,105 @@
+/**
+ * xkb settings of keyboards: controls, lock modifiers and remaps.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <X11/XKBlib.h>
+#include <X11/Xlib.h>
+
+#include "config.h"
+
+
+namespace xautocfg {
+
+/**
+ * set the repeat rate and all configured xkb controls of a keyboard.
+ *
+ * this is what XkbSetAutoRepeatRate sends, but with all other controls
+ * merged into the same SetControls request.
+ * the request is not flushed.
+ */
+void set_kbd_controls(Display *dpy, int xkb_opcode, int deviceid,
+                      const struct config::keyboard &kbd);
+
+
+/**
+ * cached lock modifier state of the core keyboard.
+ * read once at startup, then kept up to date by xkb state notify events,
+ * so new keyboards can be synced without asking the server.
+ */
+struct lock_state {
+	unsigned int locked_mods = 0;
+	unsigned int numlock_mask = 0;
+
+	/**
+	 * set the configured lock modifiers of a keyboard.
+	 * sends one LatchLockState request if anything is configured,
+	 * not flushed.
+	 */
+	void apply(Display *display, int deviceid, const struct config::keyboard &kbd) const {
+		unsigned int affect = 0;
+		unsigned int values = 0;
+
+		auto add = [&](lock_mode mode, unsigned int mask) {
+			switch (mode) {
+			case lock_mode::keep:
+				return;
+			case lock_mode::sync:
+				values |= this->locked_mods & mask;
+				break;
+			case lock_mode::on:
+				values |= mask;
+				break;
+			case lock_mode::off:
+				break;
+			}
+			affect |= mask;
+		};
+
+		add(kbd.capslock, LockMask);
+		add(kbd.numlock, this->numlock_mask);
+
+		if (affect) {
+			XkbLockModifiers(display, deviceid, affect, values);
+		}
+	}
+};
+
+
+/**
+ * keysym remappings of one keyboard.
+ *
+ * they are always worked out against the keymap the keyboard had before
+ * we changed it, fetched once, so applying them again or applying other
+ * ones replaces what we did instead of stacking on it: a swap stays a swap.
+ */
+class keymap_remap {
+public:
+	/**
+	 * send the keys that differ from what the keyboard got last,
+	 * in a single SetMap request. nothing if the remaps are the same.
+	 * the first remap of a device fetches its keymap.
+	 * the request is not flushed, so it can go out together with
+	 * the other device settings.
+	 */
+	void apply(Display *display, int deviceid, const std::vector<remap> &remaps);
+
+private:
+	struct xkb_free {
+		void operator ()(XkbDescPtr xkb) const;
+	};
+
+	// keysyms and modifier map from before we remapped anything
+	std::unique_ptr<XkbDescRec, xkb_free> original;
+	std::vector<remap> applied;
+};
+
+} // namespace xautocfg
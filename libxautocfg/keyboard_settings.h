@@ -0,0 +1,344 @@
+/**
+ * the entries of [keyboard] sections.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <X11/XKBlib.h>
+#include <X11/extensions/XKB.h>
+#include <X11/extensions/XKBproto.h>
+
+#include "config.h"
+#include "parse.h"
+#include "settings.h"
+
+
+namespace xautocfg {
+
+/**
+ * settings for setting_registry.
+ * those that have apply() go into the SetControls request of a keyboard.
+ */
+namespace keyboard_setting {
+
+using keyboard = struct config::keyboard;
+
+
+struct repeat_delay {
+	static constexpr std::string_view key = "delay";
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		int delay = parse_int(val);
+		if (delay < 0 or delay > UINT16_MAX) {
+			throw std::logic_error{std::format("delay needs to be 0 to 65535 ms, got: {}", val)};
+		}
+		kbd->delay = delay;
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return a.delay != b.delay;
+	}
+
+	static void apply(const keyboard &kbd, xkbSetControlsReq *req) {
+		req->changeCtrls |= XkbRepeatKeysMask;
+		req->repeatDelay = kbd.delay;
+	}
+};
+
+
+struct repeat_rate {
+	static constexpr std::string_view key = "rate";
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		int rate = parse_int(val);
+		if (rate < 1 or rate > 1000) {
+			throw std::logic_error{std::format("rate needs to be 1 to 1000 per second, got: {}", val)};
+		}
+		// xserver wants the repeat-interval in ms,
+		// but xset r rate delay repeat rate,
+		// so interval = 1000Hz / rate
+		kbd->interval = 1000.f / rate;
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return a.interval != b.interval;
+	}
+
+	static void apply(const keyboard &kbd, xkbSetControlsReq *req) {
+		req->changeCtrls |= XkbRepeatKeysMask;
+		req->repeatInterval = kbd.interval;
+	}
+};
+
+
+template <fixed_string Key, hook_set keyboard::*Hooks>
+struct hook {
+	static constexpr std::string_view key = Key;
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		(kbd->*Hooks).get("").set(val);
+	}
+};
+
+
+template <fixed_string Key, hook_set keyboard::*Hooks>
+struct memoize {
+	static constexpr std::string_view key = Key;
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		(kbd->*Hooks).memoize = parse_memoize(val);
+	}
+};
+
+
+/**
+ * on_connect.<name> = command and on_connect.<name>.after = names...,
+ * the same for on_disconnect.
+ * the keys aren't fixed, so this isn't in the registry.
+ */
+struct named_hook {
+	static bool parse(keyboard *kbd, std::string_view key, const std::string &val) {
+		hook_set *hooks;
+		if (key.starts_with("on_connect.")) {
+			hooks = &kbd->on_connect;
+			key.remove_prefix(std::string_view{"on_connect."}.size());
+		}
+		else if (key.starts_with("on_disconnect.")) {
+			hooks = &kbd->on_disconnect;
+			key.remove_prefix(std::string_view{"on_disconnect."}.size());
+		}
+		else {
+			return false;
+		}
+
+		bool after = key.ends_with(".after");
+		if (after) {
+			key.remove_suffix(std::string_view{".after"}.size());
+		}
+		if (key.empty() or key.find('.') != std::string_view::npos) {
+			throw std::logic_error{std::format("invalid hook name: {}", key)};
+		}
+
+		hook_command &hook = hooks->get(std::string{key});
+		if (after) {
+			hook.after.clear();
+			std::istringstream names{val};
+			for (std::string name; names >> name;) {
+				hook.after.push_back(std::move(name));
+			}
+		}
+		else {
+			hook.set(val);
+		}
+		return true;
+	}
+};
+
+
+struct hook_timeout {
+	static constexpr std::string_view key = "hook_timeout";
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		kbd->hook_timeout = std::chrono::seconds{val == "off" ? 0 : parse_int(val)};
+		if (kbd->hook_timeout.count() < 0) {
+			throw std::logic_error{std::format("expected off or seconds, got: {}", val)};
+		}
+	}
+};
+
+
+struct remaps {
+	static constexpr std::string_view key = "remap";
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		kbd->remaps.push_back(parse_remap(val));
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return a.remaps != b.remaps;
+	}
+};
+
+
+/**
+ * an xkb control that is just switched on or off.
+ */
+template <fixed_string Key, uint32_t Mask>
+struct bool_control {
+	static constexpr std::string_view key = Key;
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		kbd->controls.set_enabled(Mask, parse_bool(val));
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return ((a.controls.affect_enabled ^ b.controls.affect_enabled)
+		        | (a.controls.enabled ^ b.controls.enabled)) & Mask;
+	}
+
+	static void apply(const keyboard &kbd, xkbSetControlsReq *req) {
+		req->affectEnabledCtrls |= kbd.controls.affect_enabled & Mask;
+		req->enabledCtrls |= kbd.controls.enabled & Mask;
+	}
+};
+
+
+/**
+ * an xkb control that is off or on with a delay in ms.
+ */
+template <fixed_string Key, uint32_t Mask,
+          uint16_t xkb_controls::*Delay, CARD16 xkbSetControlsReq::*Field>
+struct delay_control {
+	static constexpr std::string_view key = Key;
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		auto delay = parse_delay(val);
+		if (delay == 0) {
+			// the server would take every key press as slow or bouncing
+			throw std::logic_error{std::format("{} needs off or a delay above 0 ms, got: {}", key, val)};
+		}
+		kbd->controls.set_enabled(Mask, delay.has_value());
+		if (delay) {
+			kbd->controls.change |= Mask;
+			kbd->controls.*Delay = *delay;
+		}
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return bool_control<Key, Mask>::differs(a, b)
+		       or ((a.controls.change ^ b.controls.change) & Mask)
+		       or a.controls.*Delay != b.controls.*Delay;
+	}
+
+	static void apply(const keyboard &kbd, xkbSetControlsReq *req) {
+		bool_control<Key, Mask>::apply(kbd, req);
+		if (kbd.controls.change & Mask) {
+			req->changeCtrls |= Mask;
+			req->*Field = kbd.controls.*Delay;
+		}
+	}
+};
+
+
+struct ignore_lock_mods {
+	static constexpr std::string_view key = "ignore_lock_mods";
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		kbd->controls.change |= XkbIgnoreLockModsMask;
+		kbd->controls.ignore_lock_mods = parse_modmask(val);
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return ((a.controls.change ^ b.controls.change) & XkbIgnoreLockModsMask)
+		       or a.controls.ignore_lock_mods != b.controls.ignore_lock_mods;
+	}
+
+	static void apply(const keyboard &kbd, xkbSetControlsReq *req) {
+		if (kbd.controls.change & XkbIgnoreLockModsMask) {
+			req->changeCtrls |= XkbIgnoreLockModsMask;
+			req->affectIgnoreLockMods = 0xff;
+			req->ignoreLockMods = kbd.controls.ignore_lock_mods;
+		}
+	}
+};
+
+
+struct norepeat {
+	static constexpr std::string_view key = "norepeat";
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		kbd->controls.change |= XkbPerKeyRepeatMask;
+		kbd->controls.per_key_repeat = parse_norepeat(val);
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return ((a.controls.change ^ b.controls.change) & XkbPerKeyRepeatMask)
+		       or a.controls.per_key_repeat != b.controls.per_key_repeat;
+	}
+
+	static void apply(const keyboard &kbd, xkbSetControlsReq *req) {
+		if (kbd.controls.change & XkbPerKeyRepeatMask) {
+			req->changeCtrls |= XkbPerKeyRepeatMask;
+			std::ranges::copy(kbd.controls.per_key_repeat, req->perKeyRepeat);
+		}
+	}
+};
+
+
+/**
+ * lock modifiers aren't controls, they are sent with lock_state.
+ */
+template <fixed_string Key, lock_mode keyboard::*Mode>
+struct lock {
+	static constexpr std::string_view key = Key;
+
+	static void parse(keyboard *kbd, const std::string &val) {
+		kbd->*Mode = parse_lock_mode(val);
+	}
+
+	static bool differs(const keyboard &a, const keyboard &b) {
+		return a.*Mode != b.*Mode;
+	}
+};
+
+} // namespace keyboard_setting
+
+
+using keyboard_settings = setting_registry<
+	struct config::keyboard,
+	keyboard_setting::repeat_delay,
+	keyboard_setting::repeat_rate,
+	keyboard_setting::hook<"on_connect", &config::keyboard::on_connect>,
+	keyboard_setting::hook<"on_disconnect", &config::keyboard::on_disconnect>,
+	keyboard_setting::memoize<"on_connect_memoize", &config::keyboard::on_connect>,
+	keyboard_setting::memoize<"on_disconnect_memoize", &config::keyboard::on_disconnect>,
+	keyboard_setting::hook_timeout,
+	keyboard_setting::remaps,
+	keyboard_setting::bool_control<"sticky_keys", XkbStickyKeysMask>,
+	keyboard_setting::delay_control<"slow_keys", XkbSlowKeysMask,
+	                                &xkb_controls::slow_keys_delay, &xkbSetControlsReq::slowKeysDelay>,
+	keyboard_setting::delay_control<"bounce_keys", XkbBounceKeysMask,
+	                                &xkb_controls::debounce_delay, &xkbSetControlsReq::debounceDelay>,
+	keyboard_setting::bool_control<"mouse_keys", XkbMouseKeysMask>,
+	keyboard_setting::bool_control<"mouse_keys_accel", XkbMouseKeysAccelMask>,
+	keyboard_setting::ignore_lock_mods,
+	keyboard_setting::lock<"capslock", &config::keyboard::capslock>,
+	keyboard_setting::lock<"numlock", &config::keyboard::numlock>,
+	keyboard_setting::norepeat
+>;
+
+
+/**
+ * what a quirk database entry may set: controls, rate and remaps.
+ * hooks would run commands from a file that isn't the user's config.
+ */
+using quirk_settings = setting_registry<
+	struct config::keyboard,
+	keyboard_setting::repeat_delay,
+	keyboard_setting::repeat_rate,
+	keyboard_setting::remaps,
+	keyboard_setting::bool_control<"sticky_keys", XkbStickyKeysMask>,
+	keyboard_setting::delay_control<"slow_keys", XkbSlowKeysMask,
+	                                &xkb_controls::slow_keys_delay, &xkbSetControlsReq::slowKeysDelay>,
+	keyboard_setting::delay_control<"bounce_keys", XkbBounceKeysMask,
+	                                &xkb_controls::debounce_delay, &xkbSetControlsReq::debounceDelay>,
+	keyboard_setting::bool_control<"mouse_keys", XkbMouseKeysMask>,
+	keyboard_setting::bool_control<"mouse_keys_accel", XkbMouseKeysAccelMask>,
+	keyboard_setting::ignore_lock_mods,
+	keyboard_setting::norepeat
+>;
+
+} // namespace xautocfg
@@ -0,0 +1,35 @@
+/**
+ * where the library's messages go.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "log.h"
+
+#include <iostream>
+#include <utility>
+
+
+namespace xautocfg {
+
+static log_handler handler;
+
+
+void set_log_handler(log_handler next) {
+	handler = std::move(next);
+}
+
+
+log_message::~log_message() {
+	std::string message = std::move(this->text).str();
+	if (handler) {
+		handler(this->level, message);
+		return;
+	}
+	// the daemon's output is a log already, errors are in line with the rest
+	std::cout << message << std::endl;
+}
+
+} // namespace xautocfg
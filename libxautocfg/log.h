@@ -0,0 +1,70 @@
+/**
+ * where the library's messages go.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <functional>
+#include <sstream>
+#include <string_view>
+
+
+namespace xautocfg {
+
+enum class log_level {
+	info,
+	error,
+};
+
+/**
+ * gets each message as one line, without the newline.
+ */
+using log_handler = std::function<void(log_level level, std::string_view message)>;
+
+/**
+ * send the messages to a handler of the host program,
+ * an empty one restores the default, which writes them to stdout.
+ * not synchronized, set it before creating instances.
+ */
+void set_log_handler(log_handler handler);
+
+
+/**
+ * collects one message, which is sent when it goes out of scope:
+ *   log_info() << "device=" << deviceid;
+ */
+class log_message {
+public:
+	explicit log_message(log_level level)
+		:
+		level{level} {}
+	~log_message();
+
+	log_message(const log_message &) = delete;
+	log_message &operator =(const log_message &) = delete;
+
+	template <typename T>
+	log_message &operator <<(const T &value) {
+		this->text << value;
+		return *this;
+	}
+
+private:
+	log_level level;
+	std::ostringstream text;
+};
+
+
+inline log_message log_info() {
+	return log_message{log_level::info};
+}
+
+inline log_message log_error() {
+	return log_message{log_level::error};
+}
+
+} // namespace xautocfg
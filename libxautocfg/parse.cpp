@@ -0,0 +1,167 @@
+/**
+ * parsers for config values.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "parse.h"
+
+#include <format>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+using namespace std::literals;
+
+
+namespace xautocfg {
+
+remap parse_remap(const std::string& val) {
+	std::istringstream vals{val};
+	std::string from, to;
+	vals >> from >> to;
+
+	if (from.empty() or to.empty() or not vals.eof()) {
+		throw std::logic_error{std::format("remap needs 'from_keysym to_keysym', got: {}", val)};
+	}
+
+	remap ret{XStringToKeysym(from.c_str()), XStringToKeysym(to.c_str())};
+	if (ret.from == NoSymbol) {
+		throw std::logic_error{std::format("unknown keysym: {}", from)};
+	}
+	if (ret.to == NoSymbol) {
+		throw std::logic_error{std::format("unknown keysym: {}", to)};
+	}
+	return ret;
+}
+
+
+bool parse_bool(const std::string& val) {
+	if (val == "on"sv or val == "yes"sv or val == "true"sv or val == "1"sv) {
+		return true;
+	}
+	if (val == "off"sv or val == "no"sv or val == "false"sv or val == "0"sv) {
+		return false;
+	}
+	throw std::logic_error{std::format("expected on or off, got: {}", val)};
+}
+
+
+hook_memoize parse_memoize(const std::string& val) {
+	if (val == "on"sv or val == "off"sv) {
+		return {parse_bool(val)};
+	}
+	std::istringstream vals{val};
+	uint64_t ttl;
+	vals >> ttl;
+	if (vals.fail() or not vals.eof() or ttl == 0) {
+		throw std::logic_error{std::format("expected on, off or a time to live in seconds, got: {}", val)};
+	}
+	return {true, std::chrono::seconds{ttl}};
+}
+
+
+lock_mode parse_lock_mode(const std::string& val) {
+	if (val == "keep"sv) {
+		return lock_mode::keep;
+	}
+	if (val == "sync"sv) {
+		return lock_mode::sync;
+	}
+	return parse_bool(val) ? lock_mode::on : lock_mode::off;
+}
+
+
+std::optional<uint16_t> parse_delay(const std::string& val) {
+	if (val == "off"sv) {
+		return std::nullopt;
+	}
+	std::istringstream vals{val};
+	uint16_t delay;
+	vals >> delay;
+	if (vals.fail() or not vals.eof()) {
+		throw std::logic_error{std::format("expected off or a delay in ms, got: {}", val)};
+	}
+	return delay;
+}
+
+
+uint8_t parse_modmask(const std::string& val) {
+	static const std::unordered_map<std::string_view, uint8_t> mods{
+		{"Shift", ShiftMask}, {"Lock", LockMask}, {"Control", ControlMask},
+		{"Mod1", Mod1Mask}, {"Mod2", Mod2Mask}, {"Mod3", Mod3Mask},
+		{"Mod4", Mod4Mask}, {"Mod5", Mod5Mask},
+	};
+
+	std::istringstream vals{val};
+	std::string mod;
+	uint8_t ret = 0;
+	while (vals >> mod) {
+		auto it = mods.find(mod);
+		if (it == mods.end()) {
+			throw std::logic_error{std::format("unknown modifier: {}", mod)};
+		}
+		ret |= it->second;
+	}
+	return ret;
+}
+
+
+std::array<uint8_t, XkbPerKeyBitArraySize> parse_norepeat(const std::string& val) {
+	std::array<uint8_t, XkbPerKeyBitArraySize> ret;
+	ret.fill(0xff);
+
+	std::istringstream vals{val};
+	std::string range;
+	while (vals >> range) {
+		unsigned first, last;
+		char dash;
+		std::istringstream rangevals{range};
+		rangevals >> first;
+		last = first;
+		if (rangevals >> dash) {
+			if (dash != '-' or not (rangevals >> last)) {
+				throw std::logic_error{std::format("invalid keycode range: {}", range)};
+			}
+		}
+		if (rangevals.fail() or first > last or last > XkbMaxLegalKeyCode) {
+			throw std::logic_error{std::format("invalid keycode range: {}", range)};
+		}
+		for (unsigned kc = first; kc <= last; kc++) {
+			ret[kc / 8] &= ~(1 << (kc % 8));
+		}
+	}
+	return ret;
+}
+
+
+int parse_int(const std::string& val) {
+	std::istringstream vals{val};
+	int ret;
+	vals >> ret;
+	if (vals.fail() or not vals.eof()) {
+		throw std::logic_error{std::format("expected a number, got: {}", val)};
+	}
+	return ret;
+}
+
+
+int parse_clock(const std::string& val) {
+	std::istringstream vals{val};
+	int hours, minutes;
+	char colon;
+	vals >> hours >> colon >> minutes;
+	if (vals.fail() or not vals.eof() or colon != ':'
+	    or hours < 0 or hours > 23 or minutes < 0 or minutes > 59) {
+		throw std::logic_error{std::format("expected a time as HH:MM, got: {}", val)};
+	}
+	return hours * 60 + minutes;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,64 @@
+/**
+ * parsers for config values.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include <X11/XKBlib.h>
+
+#include "config.h"
+
+
+namespace xautocfg {
+
+// all of them throw std::logic_error for invalid values.
+
+/**
+ * 'Caps_Lock Escape' to a keysym remap.
+ */
+remap parse_remap(const std::string& val);
+
+/**
+ * on/off, yes/no, true/false or 1/0.
+ */
+bool parse_bool(const std::string& val);
+
+/**
+ * 'on', 'off' or a time to live in seconds.
+ */
+hook_memoize parse_memoize(const std::string& val);
+
+lock_mode parse_lock_mode(const std::string& val);
+
+/**
+ * 'off' or a delay in ms.
+ */
+std::optional<uint16_t> parse_delay(const std::string& val);
+
+/**
+ * 'Lock Mod2' to LockMask | Mod2Mask.
+ */
+uint8_t parse_modmask(const std::string& val);
+
+/**
+ * '37 50 64-66' to a per-key bit array with these keycodes cleared.
+ */
+std::array<uint8_t, XkbPerKeyBitArraySize> parse_norepeat(const std::string& val);
+
+int parse_int(const std::string& val);
+
+/**
+ * 'HH:MM' to minutes after midnight.
+ */
+int parse_clock(const std::string& val);
+
+} // namespace xautocfg
@@ -0,0 +1,242 @@
+/**
+ * compiled database of per-model keyboard settings.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "quirks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "keyboard_settings.h"
+#include "log.h"
+
+namespace xautocfg {
+
+quirk_db::~quirk_db() {
+	this->close();
+}
+
+
+void quirk_db::close() {
+	if (this->data) {
+		munmap(const_cast<char *>(this->data), this->size);
+	}
+	this->data = nullptr;
+	this->size = 0;
+}
+
+
+bool quirk_db::open(const std::string &path) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		log_error() << "failed to open quirk database '" << path << "'";
+		return false;
+	}
+
+	struct stat st;
+	void *map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 and static_cast<size_t>(st.st_size) >= sizeof(header)) {
+		map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+
+	if (map == MAP_FAILED) {
+		log_error() << "failed to map quirk database '" << path << "'";
+		return false;
+	}
+
+	const char *data = static_cast<const char *>(map);
+	const header *head = reinterpret_cast<const header *>(data);
+	if (std::memcmp(head->magic, magic, sizeof(magic)) != 0
+	    or size_for(head->count, head->text_size) != static_cast<size_t>(st.st_size)) {
+		log_error() << "invalid quirk database '" << path << "'";
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	this->close();
+	this->data = data;
+	this->size = st.st_size;
+	this->head = head;
+	this->displace = reinterpret_cast<const int32_t *>(data + sizeof(header));
+	this->slots = reinterpret_cast<const slot *>(data + slots_offset(head->count));
+	this->text = data + slots_offset(head->count) + head->count * sizeof(slot);
+
+	log_info() << "loaded quirk database '" << path << "' with "
+	           << head->count << " devices";
+	return true;
+}
+
+
+std::optional<std::string_view> quirk_db::lookup(uint32_t vendor, uint32_t product) const {
+	if (not this->data or this->head->count == 0) {
+		return std::nullopt;
+	}
+
+	uint32_t count = this->head->count;
+	uint64_t key = quirk_db::key(vendor, product);
+	int32_t seed = this->displace[hash(key, 0) % count];
+	uint64_t idx = (seed < 0) ? -static_cast<int64_t>(seed) - 1 : hash(key, seed) % count;
+	if (idx >= count) {
+		return std::nullopt;
+	}
+
+	// the hash places every key somewhere, unknown ones too
+	const slot &slot = this->slots[idx];
+	if (slot.key != key or slot.text_offset + uint64_t{slot.text_size} > this->head->text_size) {
+		return std::nullopt;
+	}
+	return std::string_view{this->text + slot.text_offset, slot.text_size};
+}
+
+
+void quirk_db::apply(std::string_view entries, struct config::keyboard *kbd) {
+	while (not entries.empty()) {
+		size_t end = entries.find('\n');
+		std::string_view line = entries.substr(0, end);
+		entries.remove_prefix(end == std::string_view::npos ? entries.size() : end + 1);
+
+		size_t eq = line.find(" = ");
+		if (eq == std::string_view::npos) {
+			continue;
+		}
+
+		try {
+			parse_entry(kbd, std::string{line.substr(0, eq)}, std::string{line.substr(eq + 3)});
+		}
+		catch (std::logic_error &err) {
+			// the database may have been built for another version
+			log_info() << "ignoring quirk entry '" << line << "': " << err.what();
+		}
+	}
+}
+
+
+void quirk_db::parse_entry(struct config::keyboard *kbd,
+                           const std::string &key,
+                           const std::string &val) {
+	if (not quirk_settings::parse(kbd, key, val)) {
+		throw std::logic_error{std::format("not allowed in quirks: {}", key)};
+	}
+}
+
+
+uint64_t quirk_db::hash(uint64_t key, uint32_t seed) {
+	// splitmix64 finalizer
+	uint64_t x = key + (seed + 1) * 0x9e3779b97f4a7c15;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+
+size_t quirk_db::slots_offset(uint32_t count) {
+	// slots are 8 byte aligned
+	return (sizeof(header) + count * sizeof(int32_t) + 7) & ~size_t{7};
+}
+
+
+size_t quirk_db::size_for(uint32_t count, uint32_t text_size) {
+	return slots_offset(count) + count * sizeof(slot) + text_size;
+}
+
+
+std::string quirk_db::build(const std::map<uint64_t, std::string> &entries) {
+	uint32_t count = entries.size();
+
+	// first level: spread the keys into buckets
+	std::vector<std::vector<uint64_t>> buckets(count);
+	for (auto &[key, text] : entries) {
+		buckets[hash(key, 0) % count].push_back(key);
+	}
+
+	// large buckets first, while there are many free slots
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; i++) {
+		order[i] = i;
+	}
+	std::ranges::stable_sort(order, [&](uint32_t a, uint32_t b) {
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	// second level: a seed for each bucket that puts all its keys in free slots
+	std::vector<int32_t> displace(count, 0);
+	std::vector<std::optional<uint64_t>> slot_keys(count);
+	std::vector<uint32_t> positions;
+	size_t next_free = 0;
+	for (uint32_t b : order) {
+		auto &bucket = buckets[b];
+		if (bucket.empty()) {
+			break;
+		}
+
+		if (bucket.size() == 1) {
+			// no hashing needed, the seed stores the slot directly
+			while (slot_keys[next_free]) {
+				next_free += 1;
+			}
+			slot_keys[next_free] = bucket[0];
+			displace[b] = -static_cast<int32_t>(next_free) - 1;
+			continue;
+		}
+
+		for (int32_t seed = 1; ; seed++) {
+			if (seed == INT32_MAX) {
+				throw std::runtime_error{"failed to find a perfect hash"};
+			}
+
+			positions.clear();
+			bool fits = true;
+			for (uint64_t key : bucket) {
+				uint32_t pos = hash(key, seed) % count;
+				if (slot_keys[pos] or std::ranges::find(positions, pos) != positions.end()) {
+					fits = false;
+					break;
+				}
+				positions.push_back(pos);
+			}
+
+			if (fits) {
+				for (size_t i = 0; i < bucket.size(); i++) {
+					slot_keys[positions[i]] = bucket[i];
+				}
+				displace[b] = seed;
+				break;
+			}
+		}
+	}
+
+	std::string text;
+	std::vector<slot> slots(count);
+	for (uint32_t i = 0; i < count; i++) {
+		const std::string &entry = entries.at(*slot_keys[i]);
+		slots[i] = {*slot_keys[i], static_cast<uint32_t>(text.size()), static_cast<uint32_t>(entry.size())};
+		text += entry;
+	}
+
+	header head{};
+	std::memcpy(head.magic, magic, sizeof(magic));
+	head.count = count;
+	head.text_size = text.size();
+
+	std::string ret(size_for(count, text.size()), '\0');
+	std::memcpy(ret.data(), &head, sizeof(head));
+	std::memcpy(ret.data() + sizeof(header), displace.data(), count * sizeof(int32_t));
+	std::memcpy(ret.data() + slots_offset(count), slots.data(), count * sizeof(slot));
+	std::memcpy(ret.data() + slots_offset(count) + count * sizeof(slot), text.data(), text.size());
+	return ret;
+}
+
+} // namespace xautocfg
@@ -0,0 +1,114 @@
+/**
+ * compiled database of per-model keyboard settings.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "config.h"
+
+
+namespace xautocfg {
+
+/**
+ * read-only quirk database, built by xautocfg-compile.
+ *
+ * maps usb/bluetooth vendor:product ids to [keyboard] entries.
+ * the file is mapped into memory and never parsed as a whole,
+ * a minimal perfect hash finds the only slot a device can be in.
+ *
+ * layout, in native byte order:
+ *   header
+ *   int32_t  displace[count]   seed for each first-level bucket
+ *   slot     slots[count]      key and entry text of each device
+ *   char     text[]            "key = value\n" lines
+ */
+class quirk_db {
+public:
+	quirk_db() = default;
+	~quirk_db();
+
+	quirk_db(const quirk_db &) = delete;
+	quirk_db &operator =(const quirk_db &) = delete;
+
+	/**
+	 * map a database file.
+	 * returns false and logs why if it can't be used.
+	 */
+	bool open(const std::string &path);
+
+	/**
+	 * unmap the database, lookups find nothing afterwards.
+	 */
+	void close();
+
+	bool is_open() const {
+		return this->data != nullptr;
+	}
+
+	/**
+	 * entries for a device, nullopt if there are none.
+	 */
+	std::optional<std::string_view> lookup(uint32_t vendor, uint32_t product) const;
+
+	/**
+	 * apply the entries returned by lookup() to keyboard settings.
+	 */
+	static void apply(std::string_view entries, struct config::keyboard *kbd);
+
+	/**
+	 * apply one 'key = value' entry of a quirk.
+	 * only controls, rate and remaps are allowed, no hooks.
+	 * throws std::logic_error for invalid entries.
+	 */
+	static void parse_entry(struct config::keyboard *kbd,
+	                        const std::string &key,
+	                        const std::string &val);
+
+	static uint64_t key(uint32_t vendor, uint32_t product) {
+		return (static_cast<uint64_t>(vendor) << 32) | product;
+	}
+
+	/**
+	 * content of a database file with these device keys and entry texts.
+	 */
+	static std::string build(const std::map<uint64_t, std::string> &entries);
+
+private:
+	struct header {
+		char magic[8];
+		uint32_t count;
+		uint32_t text_size;
+	};
+
+	struct slot {
+		uint64_t key;
+		uint32_t text_offset;
+		uint32_t text_size;
+	};
+
+	static constexpr char magic[8] = {'x', 'a', 'c', 'q', 'd', 'b', '1', '\0'};
+
+	static uint64_t hash(uint64_t key, uint32_t seed);
+	static size_t slots_offset(uint32_t count);
+	static size_t size_for(uint32_t count, uint32_t text_size);
+
+	const char *data = nullptr;
+	size_t size = 0;
+	const header *head = nullptr;
+	const int32_t *displace = nullptr;
+	const slot *slots = nullptr;
+	const char *text = nullptr;
+};
+
+} // namespace xautocfg
@@ -0,0 +1,380 @@
+/**
+ * loading X resources into RESOURCE_MANAGER, like xrdb -merge.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "resources.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xresource.h>
+#include <X11/Xutil.h>
+
+#include "log.h"
+#include "util.h"
+
+
+namespace xautocfg {
+
+/**
+ * parse 'name: value' lines, as xrdb does after preprocessing.
+ * later entries replace earlier ones.
+ */
+void parse_resources(std::string_view text, resource_db *db) {
+	std::string line;
+	auto trim = [](std::string_view str) {
+		auto begin = str.find_first_not_of(" \t");
+		if (begin == std::string_view::npos) {
+			return std::string_view{};
+		}
+		auto end = str.find_last_not_of(" \t");
+		return str.substr(begin, end - begin + 1);
+	};
+
+	size_t pos = 0;
+	while (pos < text.size()) {
+		auto end = text.find('\n', pos);
+		if (end == std::string_view::npos) {
+			end = text.size();
+		}
+		std::string_view part = text.substr(pos, end - pos);
+		pos = end + 1;
+
+		// continuation line
+		if (part.ends_with('\\')) {
+			line.append(part.substr(0, part.size() - 1));
+			continue;
+		}
+		line.append(part);
+
+		std::string_view entry = trim(line);
+		auto colon = entry.find(':');
+		if (not entry.empty() and entry[0] != '!' and entry[0] != '#'
+		    and colon != std::string_view::npos) {
+			auto name = trim(entry.substr(0, colon));
+			if (not name.empty()) {
+				(*db)[std::string{name}] = trim(entry.substr(colon + 1));
+			}
+		}
+		line.clear();
+	}
+}
+
+
+std::string serialize_resources(const resource_db &db) {
+	std::string ret;
+	for (auto &[name, value] : db) {
+		ret += name;
+		ret += ":\t";
+		ret += value;
+		ret += '\n';
+	}
+	return ret;
+}
+
+
+/**
+ * the preprocessed and merged resource files of the last run.
+ *
+ * valid as long as the preprocessor invocation and the content
+ * of every file it read are the same.
+ */
+struct resource_cache {
+	uint64_t key = 0;
+	std::vector<std::pair<std::string, uint64_t>> deps;
+	std::string content;
+
+	/**
+	 * one per display, the defines depend on its screen.
+	 */
+	static std::string path(Display *display) {
+		std::string name = DisplayString(display);
+		std::ranges::replace(name, '/', '_');
+		return xdg_path("XDG_CACHE_HOME", ".cache", std::format("resources-{}", name));
+	}
+
+	bool load(const std::string &path) {
+		std::ifstream file{path, std::ios::binary};
+		std::string magic;
+		size_t ndeps;
+		if (not (file >> magic >> this->key >> ndeps) or magic != "xautocfg-resources-1") {
+			return false;
+		}
+		for (size_t i = 0; i < ndeps; i++) {
+			uint64_t hash;
+			std::string dep;
+			if (not (file >> hash) or not std::getline(file >> std::ws, dep)) {
+				return false;
+			}
+			this->deps.emplace_back(std::move(dep), hash);
+		}
+		file.ignore(1);
+		std::ostringstream content;
+		content << file.rdbuf();
+		this->content = std::move(content).str();
+		return true;
+	}
+
+	void store(const std::string &path) const {
+		std::error_code err;
+		std::filesystem::create_directories(std::filesystem::path{path}.parent_path(), err);
+
+		std::string tmppath = path + ".tmp";
+		{
+			std::ofstream file{tmppath, std::ios::binary | std::ios::trunc};
+			file << "xautocfg-resources-1 " << this->key << " " << this->deps.size() << "\n";
+			for (auto &[dep, hash] : this->deps) {
+				file << hash << " " << dep << "\n";
+			}
+			file << "\n" << this->content;
+			if (not file) {
+				log_error() << "failed to write resource cache " << tmppath;
+				return;
+			}
+		}
+		std::filesystem::rename(tmppath, path, err);
+	}
+
+	bool up_to_date(uint64_t key) const {
+		if (key != this->key) {
+			return false;
+		}
+		return std::ranges::all_of(this->deps, [](auto &dep) {
+			auto content = read_file(dep.first);
+			return content and fnv1a(*content) == dep.second;
+		});
+	}
+};
+
+
+/**
+ * add the dependencies listed in a make-style rule, as written by cpp -MD.
+ */
+void parse_depfile(const std::string &rule, std::vector<std::string> *deps) {
+	auto colon = rule.find(": ");
+	if (colon == std::string::npos) {
+		return;
+	}
+
+	std::string dep;
+	for (size_t i = colon + 1; i <= rule.size(); i++) {
+		char c = i < rule.size() ? rule[i] : ' ';
+		if (c == '\\' and i + 1 < rule.size() and rule[i + 1] == ' ') {
+			dep += ' ';
+			i++;
+		}
+		else if (c == '\\' or c == ' ' or c == '\n' or c == '\t') {
+			if (not dep.empty()) {
+				deps->push_back(std::move(dep));
+				dep.clear();
+			}
+		}
+		else {
+			dep += c;
+		}
+	}
+}
+
+
+/**
+ * the symbols xrdb defines for the preprocessor.
+ * all of them are known from the connection setup.
+ */
+std::vector<std::string> resource_defines(Display *display) {
+	Screen *screen = DefaultScreenOfDisplay(display);
+	Visual *visual = DefaultVisualOfScreen(screen);
+	int width = WidthOfScreen(screen);
+	int height = HeightOfScreen(screen);
+
+	auto resolution = [](int pixels, int mm) {
+		return mm > 0 ? (pixels * 1000 + mm / 2) / mm : 0;
+	};
+
+	std::vector<std::string> ret{
+		std::format("-DWIDTH={}", width),
+		std::format("-DHEIGHT={}", height),
+		std::format("-DX_RESOLUTION={}", resolution(width, WidthMMOfScreen(screen))),
+		std::format("-DY_RESOLUTION={}", resolution(height, HeightMMOfScreen(screen))),
+		std::format("-DPLANES={}", DefaultDepthOfScreen(screen)),
+		std::format("-DBITS_PER_RGB={}", visual->bits_per_rgb),
+		std::format("-DVENDOR=\"{}\"", ServerVendor(display)),
+		std::format("-DVERSION={}", ProtocolVersion(display)),
+		std::format("-DREVISION={}", ProtocolRevision(display)),
+		std::format("-DRELEASE={}", VendorRelease(display)),
+	};
+	if (visual->c_class >= StaticColor) {
+		ret.push_back("-DCOLOR");
+	}
+	return ret;
+}
+
+
+/**
+ * preprocess and parse all resource files.
+ * uses the cache if none of the files changed, so cpp isn't run.
+ */
+std::optional<resource_db> load_resources(Display *display, const struct config::resources &cfg) {
+	std::vector<std::string> defines;
+	if (not cfg.cpp.empty()) {
+		defines = resource_defines(display);
+	}
+
+	uint64_t key = fnv1a(cfg.cpp);
+	for (auto &define : defines) {
+		key = fnv1a(define, key);
+	}
+	for (auto &file : cfg.files) {
+		key = fnv1a(file, key);
+	}
+
+	std::string cache_path = resource_cache::path(display);
+	resource_cache cache;
+	if (not cache_path.empty() and cache.load(cache_path) and cache.up_to_date(key)) {
+		log_info() << "resources unchanged, using cache";
+		resource_db db;
+		parse_resources(cache.content, &db);
+		return db;
+	}
+
+	cache = {};
+	cache.key = key;
+	resource_db db;
+
+	for (auto &file : cfg.files) {
+		std::vector<std::string> deps;
+		std::optional<std::string> content;
+
+		if (cfg.cpp.empty()) {
+			content = read_file(file);
+			deps.push_back(file);
+		}
+		else {
+			char depfile[] = "/tmp/xautocfg-deps-XXXXXX";
+			int depfd = mkstemp(depfile);
+			if (depfd == -1) {
+				log_error() << "failed to create dependency file: " << std::strerror(errno);
+				return std::nullopt;
+			}
+			close(depfd);
+
+			std::vector<std::string> argv;
+			std::istringstream cpp{cfg.cpp};
+			for (std::string arg; cpp >> arg;) {
+				argv.push_back(std::move(arg));
+			}
+			argv.insert(argv.end(), {"-P", "-MD", "-MF", depfile});
+			argv.insert(argv.end(), defines.begin(), defines.end());
+			argv.push_back(file);
+
+			content = exec_read(argv);
+			if (auto rule = read_file(depfile)) {
+				parse_depfile(*rule, &deps);
+			}
+			unlink(depfile);
+		}
+
+		if (not content) {
+			log_error() << "failed to load resources from " << file;
+			return std::nullopt;
+		}
+
+		parse_resources(*content, &db);
+		for (auto &dep : deps) {
+			auto dep_content = read_file(dep);
+			if (dep_content) {
+				cache.deps.emplace_back(dep, fnv1a(*dep_content));
+			}
+		}
+	}
+
+	cache.content = serialize_resources(db);
+	if (not cache_path.empty()) {
+		cache.store(cache_path);
+	}
+	return db;
+}
+
+
+/**
+ * RESOURCE_MANAGER as it is on the server now.
+ * it may have changed since we connected, by us or by xrdb.
+ */
+resource_db current_resources(Display *display) {
+	resource_db ret;
+	Atom type;
+	int format;
+	unsigned long count, remaining;
+	unsigned char *data = nullptr;
+	if (XGetWindowProperty(display, RootWindow(display, 0), XA_RESOURCE_MANAGER, 0, LONG_MAX / 4,
+	                       False, XA_STRING, &type, &format, &count, &remaining, &data) == Success
+	    and data) {
+		if (type == XA_STRING and format == 8) {
+			parse_resources({reinterpret_cast<const char *>(data), count}, &ret);
+		}
+		XFree(data);
+	}
+	return ret;
+}
+
+
+void update_resources(Display *display, const resource_db &entries) {
+	if (entries.empty()) {
+		return;
+	}
+
+	resource_db current = current_resources(display);
+	resource_db merged = current;
+	for (auto &[name, value] : entries) {
+		merged[name] = value;
+	}
+
+	if (merged == current) {
+		log_info() << "resources are up to date";
+		return;
+	}
+
+	std::string content = serialize_resources(merged);
+	log_info() << "updating resources";
+	XChangeProperty(display, RootWindow(display, 0), XA_RESOURCE_MANAGER, XA_STRING,
+	                8, PropModeReplace,
+	                reinterpret_cast<const unsigned char *>(content.data()), content.size());
+}
+
+
+void merge_resources(Display *display, const struct config::resources &cfg,
+                     const resource_db &derived) {
+	resource_db entries;
+	if (not cfg.files.empty()) {
+		if (auto loaded = load_resources(display, cfg)) {
+			entries = std::move(*loaded);
+		}
+	}
+
+	// derived values win over the files, they follow the monitors
+	for (auto &[name, value] : derived) {
+		entries[name] = value;
+	}
+	update_resources(display, entries);
+}
+
+} // namespace xautocfg
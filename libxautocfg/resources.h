@@ -0,0 +1,43 @@
+/**
+ * loading X resources into RESOURCE_MANAGER, like xrdb -merge.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <X11/Xlib.h>
+
+#include "config.h"
+
+
+namespace xautocfg {
+
+/**
+ * X resources, sorted by name.
+ */
+using resource_db = std::map<std::string, std::string>;
+
+
+/**
+ * merge the configured resource files and the derived entries
+ * into RESOURCE_MANAGER, with one write.
+ * the property is only written if this changes it.
+ * not flushed.
+ */
+void merge_resources(Display *display, const struct config::resources &cfg,
+                     const resource_db &derived = {});
+
+/**
+ * merge entries into RESOURCE_MANAGER as it is on the server now.
+ * the property is only written if this changes it.
+ * not flushed.
+ */
+void update_resources(Display *display, const resource_db &entries);
+
+} // namespace xautocfg
@@ -0,0 +1,96 @@
+/**
+ * server-wide settings, like xset sets them.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "session.h"
+
+
+#include <X11/Xlib.h>
+#include <X11/extensions/dpms.h>
+
+
+#include "log.h"
+
+namespace xautocfg {
+
+void session_settings::apply(Display *display, session_settings *applied) const {
+	auto changed = [](auto &want, auto &have) {
+		return want.has_value() and want != have;
+	};
+
+	XKeyboardControl kbd_ctrl{};
+	unsigned long kbd_mask = 0;
+	if (changed(this->bell_percent, applied->bell_percent)) {
+		kbd_ctrl.bell_percent = *this->bell_percent;
+		kbd_mask |= KBBellPercent;
+	}
+	if (changed(this->bell_pitch, applied->bell_pitch)) {
+		kbd_ctrl.bell_pitch = *this->bell_pitch;
+		kbd_mask |= KBBellPitch;
+	}
+	if (changed(this->bell_duration, applied->bell_duration)) {
+		kbd_ctrl.bell_duration = *this->bell_duration;
+		kbd_mask |= KBBellDuration;
+	}
+	if (kbd_mask) {
+		log_info() << "setting bell";
+		XChangeKeyboardControl(display, kbd_mask, &kbd_ctrl);
+	}
+
+	if (changed(this->screensaver_timeout, applied->screensaver_timeout)
+	    or changed(this->screensaver_cycle, applied->screensaver_cycle)) {
+		log_info() << "setting screensaver";
+		// -1 restores the server default
+		XSetScreenSaver(display,
+		                this->screensaver_timeout.value_or(-1),
+		                this->screensaver_cycle.value_or(-1),
+		                DefaultBlanking, DefaultExposures);
+	}
+
+	if (changed(this->dpms, applied->dpms)) {
+		int dpms_event, dpms_error;
+		if (not DPMSQueryExtension(display, &dpms_event, &dpms_error)) {
+			// not asked again on this connection, the server won't get it
+			log_info() << "no dpms extension, skipping dpms";
+		}
+		else if (auto &timeouts = *this->dpms) {
+			log_info() << "setting dpms";
+			DPMSSetTimeouts(display, (*timeouts)[0], (*timeouts)[1], (*timeouts)[2]);
+			DPMSEnable(display);
+		}
+		else {
+			log_info() << "setting dpms";
+			DPMSDisable(display);
+		}
+	}
+
+	bool do_accel = changed(this->pointer_accel, applied->pointer_accel);
+	bool do_threshold = changed(this->pointer_threshold, applied->pointer_threshold);
+	if (do_accel or do_threshold) {
+		log_info() << "setting pointer acceleration";
+		auto accel = this->pointer_accel.value_or(std::pair{1, 1});
+		XChangePointerControl(display, do_accel, do_threshold,
+		                      accel.first, accel.second,
+		                      this->pointer_threshold.value_or(0));
+	}
+
+	auto keep_unset = [](auto &want, auto &have) {
+		if (want.has_value()) {
+			have = want;
+		}
+	};
+	keep_unset(this->bell_percent, applied->bell_percent);
+	keep_unset(this->bell_pitch, applied->bell_pitch);
+	keep_unset(this->bell_duration, applied->bell_duration);
+	keep_unset(this->screensaver_timeout, applied->screensaver_timeout);
+	keep_unset(this->screensaver_cycle, applied->screensaver_cycle);
+	keep_unset(this->dpms, applied->dpms);
+	keep_unset(this->pointer_accel, applied->pointer_accel);
+	keep_unset(this->pointer_threshold, applied->pointer_threshold);
+}
+
+} // namespace xautocfg
@@ -0,0 +1,47 @@
+/**
+ * server-wide settings, like xset sets them.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include <X11/Xlib.h>
+
+
+namespace xautocfg {
+
+/**
+ * server-wide settings, like xset sets them.
+ * unset values are left as they are.
+ */
+struct session_settings {
+	std::optional<int> bell_percent;
+	std::optional<int> bell_pitch;
+	std::optional<int> bell_duration;
+
+	std::optional<int> screensaver_timeout;
+	std::optional<int> screensaver_cycle;
+
+	// standby, suspend, off in seconds, or nullopt to disable dpms
+	std::optional<std::optional<std::array<uint16_t, 3>>> dpms;
+
+	// acceleration numerator and denominator
+	std::optional<std::pair<int, int>> pointer_accel;
+	std::optional<int> pointer_threshold;
+
+	/**
+	 * send everything that differs from what was applied before.
+	 * not flushed, so all settings go out in one batch.
+	 */
+	void apply(Display *display, session_settings *applied) const;
+};
+
+} // namespace xautocfg
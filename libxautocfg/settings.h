@@ -0,0 +1,129 @@
+/**
+ * compile-time registry of settings.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+
+namespace xautocfg {
+
+/**
+ * string literal as template argument.
+ */
+template <size_t N>
+struct fixed_string {
+	constexpr fixed_string(const char (&str)[N]) {
+		std::copy_n(str, N, this->data);
+	}
+
+	constexpr operator std::string_view() const {
+		return {this->data, N - 1};
+	}
+
+	char data[N];
+};
+
+
+/**
+ * a setting is a policy class for one config key of a Target:
+ *
+ *   static constexpr std::string_view key;
+ *   static void parse(Target *, const std::string &val);
+ *
+ * and, if it changes what is sent to a device:
+ *
+ *   static bool differs(const Target &, const Target &);
+ *   static void apply(const Target &, Batch *);
+ */
+template <typename S, typename Target>
+concept setting = requires(Target *target, const std::string &val) {
+	{ S::key } -> std::convertible_to<std::string_view>;
+	S::parse(target, val);
+};
+
+
+/**
+ * all settings of a Target, resolved at compile time.
+ *
+ * keys are looked up in a table sorted while compiling,
+ * duplicate keys fail the build.
+ * apply() and differs() expand to the calls of the settings that have them,
+ * in the order the settings are listed.
+ */
+template <typename Target, typename... Settings>
+requires (setting<Settings, Target> and ...)
+class setting_registry {
+public:
+	/**
+	 * parse the value of a key, false if there is no such key.
+	 */
+	static bool parse(Target *target, std::string_view key, const std::string &val) {
+		auto it = std::ranges::lower_bound(table, key, {}, &entry::key);
+		if (it == table.end() or it->key != key) {
+			return false;
+		}
+		it->parse(target, val);
+		return true;
+	}
+
+	/**
+	 * would applying b send something else than a?
+	 */
+	static bool differs(const Target &a, const Target &b) {
+		return (differs_one<Settings>(a, b) or ...);
+	}
+
+	/**
+	 * add all settings to one batched request.
+	 */
+	template <typename Batch>
+	static void apply(const Target &target, Batch *batch) {
+		(apply_one<Settings>(target, batch), ...);
+	}
+
+private:
+	struct entry {
+		std::string_view key;
+		void (*parse)(Target *, const std::string &);
+	};
+
+	static constexpr std::array<entry, sizeof...(Settings)> table = [] {
+		std::array<entry, sizeof...(Settings)> ret{{{Settings::key, &Settings::parse}...}};
+		std::ranges::sort(ret, {}, &entry::key);
+		for (size_t i = 1; i < ret.size(); i++) {
+			if (ret[i - 1].key == ret[i].key) {
+				throw std::logic_error{"duplicate setting key"};
+			}
+		}
+		return ret;
+	}();
+
+	template <typename S>
+	static bool differs_one(const Target &a, const Target &b) {
+		if constexpr (requires { S::differs(a, b); }) {
+			return S::differs(a, b);
+		}
+		return false;
+	}
+
+	template <typename S, typename Batch>
+	static void apply_one(const Target &target, Batch *batch) {
+		if constexpr (requires { S::apply(target, batch); }) {
+			S::apply(target, batch);
+		}
+	}
+};
+
+} // namespace xautocfg
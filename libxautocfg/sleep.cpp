@@ -0,0 +1,103 @@
+/**
+ * suspend and resume notifications from logind.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "sleep.h"
+
+#include <cstring>
+#include <utility>
+
+#ifdef XAUTOCFG_LOGIND
+#include <systemd/sd-bus.h>
+#endif
+
+
+#include "log.h"
+
+namespace xautocfg {
+
+#ifdef XAUTOCFG_LOGIND
+
+sleep_monitor::sleep_monitor(callback on_change)
+	:
+	on_change{std::move(on_change)} {
+
+	int ret = sd_bus_open_system(&this->bus);
+	if (ret < 0) {
+		log_error() << "failed to connect to the system bus: " << std::strerror(-ret);
+		this->bus = nullptr;
+		return;
+	}
+
+	ret = sd_bus_match_signal(this->bus, &this->match,
+	                          "org.freedesktop.login1", "/org/freedesktop/login1",
+	                          "org.freedesktop.login1.Manager", "PrepareForSleep",
+	                          &sleep_monitor::handle_signal, this);
+	if (ret < 0) {
+		log_error() << "failed to watch for suspend: " << std::strerror(-ret);
+		this->bus = sd_bus_flush_close_unref(this->bus);
+	}
+}
+
+
+sleep_monitor::~sleep_monitor() {
+	sd_bus_slot_unref(this->match);
+	sd_bus_flush_close_unref(this->bus);
+}
+
+
+int sleep_monitor::fd() const {
+	return this->bus ? sd_bus_get_fd(this->bus) : -1;
+}
+
+
+void sleep_monitor::dispatch() {
+	if (not this->bus) {
+		return;
+	}
+
+	int ret;
+	while ((ret = sd_bus_process(this->bus, nullptr)) > 0) {}
+	if (ret < 0) {
+		// logind restarts don't drop the bus, so this is the bus itself going away
+		log_error() << "lost the system bus: " << std::strerror(-ret);
+		sd_bus_slot_unref(this->match);
+		this->match = nullptr;
+		this->bus = sd_bus_flush_close_unref(this->bus);
+	}
+}
+
+
+int sleep_monitor::handle_signal(sd_bus_message *msg, void *self, sd_bus_error *) {
+	int sleeping;
+	if (sd_bus_message_read(msg, "b", &sleeping) < 0) {
+		return 0;
+	}
+	static_cast<sleep_monitor *>(self)->on_change(sleeping);
+	return 0;
+}
+
+#else
+
+sleep_monitor::sleep_monitor(callback on_change)
+	:
+	on_change{std::move(on_change)} {}
+
+
+sleep_monitor::~sleep_monitor() = default;
+
+
+int sleep_monitor::fd() const {
+	return -1;
+}
+
+
+void sleep_monitor::dispatch() {}
+
+#endif
+
+} // namespace xautocfg
@@ -0,0 +1,65 @@
+/**
+ * suspend and resume notifications from logind.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <functional>
+
+
+#ifdef XAUTOCFG_LOGIND
+struct sd_bus;
+struct sd_bus_error;
+struct sd_bus_message;
+struct sd_bus_slot;
+#endif
+
+
+namespace xautocfg {
+
+/**
+ * listens for logind's PrepareForSleep signal on the system bus.
+ * $DBUS_SYSTEM_BUS_ADDRESS selects another bus, e.g. a test daemon.
+ *
+ * only built with XAUTOCFG_LOGIND (make LOGIND=1), otherwise and
+ * without a system bus there's nothing to listen to and fd() is -1.
+ */
+class sleep_monitor {
+public:
+	/**
+	 * called with true before the system sleeps, with false after it resumed.
+	 */
+	using callback = std::function<void(bool sleeping)>;
+
+	explicit sleep_monitor(callback on_change);
+	~sleep_monitor();
+
+	sleep_monitor(const sleep_monitor &) = delete;
+	sleep_monitor &operator =(const sleep_monitor &) = delete;
+
+	/**
+	 * readable when there are messages, then call dispatch().
+	 */
+	int fd() const;
+
+	/**
+	 * process all messages that arrived.
+	 */
+	void dispatch();
+
+private:
+	callback on_change;
+
+#ifdef XAUTOCFG_LOGIND
+	static int handle_signal(sd_bus_message *msg, void *self, sd_bus_error *error);
+
+	sd_bus *bus = nullptr;
+	sd_bus_slot *match = nullptr;
+#endif
+};
+
+} // namespace xautocfg
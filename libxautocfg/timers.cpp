@@ -0,0 +1,246 @@
+/**
+ * timers on a single timerfd.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "timers.h"
+
+#include <algorithm>
+#include <bit>
+#include <ctime>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+
+namespace xautocfg {
+
+timer_wheel::timer_wheel()
+	:
+	current{now()} {
+
+	this->heads.fill(none);
+	this->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (this->timerfd == -1) {
+		throw std::runtime_error{"failed to create timerfd"};
+	}
+}
+
+
+timer_wheel::~timer_wheel() {
+	close(this->timerfd);
+}
+
+
+timer_wheel::handle timer_wheel::add(std::chrono::milliseconds delay, callback func) {
+	uint32_t idx = this->free_list;
+	if (idx != none) {
+		this->free_list = this->nodes[idx].next;
+	}
+	else {
+		idx = this->nodes.size();
+		this->nodes.emplace_back();
+	}
+
+	// timers are placed relative to the wheel time
+	uint64_t time = now();
+	this->advance(time);
+
+	node &timer = this->nodes[idx];
+	timer.deadline = time + std::max<int64_t>(delay.count(), 0);
+	timer.func = std::move(func);
+	this->link(idx);
+	this->count += 1;
+
+	this->rearm();
+	return {idx, timer.generation};
+}
+
+
+void timer_wheel::cancel(handle &timer) {
+	if (this->active(timer)) {
+		this->unlink(timer.index);
+		this->release(timer.index);
+		if (this->count == 0) {
+			this->rearm();
+		}
+	}
+	timer = {};
+}
+
+
+bool timer_wheel::active(const handle &timer) const {
+	return timer.index < this->nodes.size()
+	       and this->nodes[timer.index].generation == timer.generation
+	       and this->nodes[timer.index].list != none;
+}
+
+
+void timer_wheel::dispatch() {
+	uint64_t expirations;
+	if (read(this->timerfd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+		this->armed = 0;
+	}
+
+	this->advance(now());
+
+	// callbacks may add timers that are already expired, those run next time
+	std::vector<uint32_t> fire;
+	while (this->heads[expired] != none) {
+		fire.push_back(this->heads[expired]);
+		this->unlink(this->heads[expired]);
+	}
+
+	for (uint32_t idx : fire) {
+		callback func = std::move(this->nodes[idx].func);
+		this->release(idx);
+		func();
+	}
+
+	this->rearm();
+}
+
+
+uint64_t timer_wheel::now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+void timer_wheel::link(uint32_t idx) {
+	node &timer = this->nodes[idx];
+
+	uint32_t list = expired;
+	if (timer.deadline > this->current) {
+		int level = (std::bit_width(timer.deadline ^ this->current) - 1) / level_bits;
+		int shift = level * level_bits;
+		uint64_t index = timer.deadline >> shift;
+		if (level >= levels) {
+			// too far away, park it in the last slot and place it again from there
+			level = levels - 1;
+			shift = level * level_bits;
+			index = (this->current >> shift) + slots - 1;
+		}
+		uint32_t slot = index & (slots - 1);
+		list = level * slots + slot;
+		this->occupied[level] |= uint64_t{1} << slot;
+	}
+
+	timer.list = list;
+	timer.prev = none;
+	timer.next = this->heads[list];
+	if (timer.next != none) {
+		this->nodes[timer.next].prev = idx;
+	}
+	this->heads[list] = idx;
+}
+
+
+void timer_wheel::unlink(uint32_t idx) {
+	node &timer = this->nodes[idx];
+	if (timer.prev != none) {
+		this->nodes[timer.prev].next = timer.next;
+	}
+	else {
+		this->heads[timer.list] = timer.next;
+	}
+	if (timer.next != none) {
+		this->nodes[timer.next].prev = timer.prev;
+	}
+
+	if (timer.list != expired and this->heads[timer.list] == none) {
+		this->occupied[timer.list / slots] &= ~(uint64_t{1} << (timer.list % slots));
+	}
+	timer.list = none;
+}
+
+
+void timer_wheel::release(uint32_t idx) {
+	node &timer = this->nodes[idx];
+	timer.func = {};
+	timer.generation += 1;
+	timer.next = this->free_list;
+	this->free_list = idx;
+	this->count -= 1;
+}
+
+
+void timer_wheel::advance(uint64_t to) {
+	if (to <= this->current) {
+		return;
+	}
+
+	std::vector<uint32_t> moved;
+	for (int level = 0; level < levels; level++) {
+		int shift = level * level_bits;
+		uint64_t from_index = this->current >> shift;
+		uint64_t to_index = to >> shift;
+		if (from_index == to_index) {
+			// higher levels haven't moved either
+			break;
+		}
+
+		// slots whose time has come, up to and including the new one
+		uint64_t passed = ~uint64_t{0};
+		if (to_index - from_index < slots) {
+			passed = 0;
+			for (uint64_t index = from_index + 1; index <= to_index; index++) {
+				passed |= uint64_t{1} << (index & (slots - 1));
+			}
+		}
+
+		for (uint64_t pending = passed & this->occupied[level]; pending; pending &= pending - 1) {
+			uint32_t list = level * slots + std::countr_zero(pending);
+			while (this->heads[list] != none) {
+				moved.push_back(this->heads[list]);
+				this->unlink(this->heads[list]);
+			}
+		}
+	}
+
+	this->current = to;
+
+	// into a lower level, or expired
+	for (uint32_t idx : moved) {
+		this->link(idx);
+	}
+}
+
+
+void timer_wheel::rearm() {
+	uint64_t next = 0;
+	if (this->heads[expired] != none) {
+		next = this->current;
+	}
+	else {
+		for (int level = 0; level < levels; level++) {
+			if (not this->occupied[level]) {
+				continue;
+			}
+
+			// the first occupied slot after the current one
+			int shift = level * level_bits;
+			uint64_t index = this->current >> shift;
+			int offset = std::countr_zero(std::rotr(this->occupied[level], (index + 1) % slots)) + 1;
+			uint64_t start = (index + offset) << shift;
+			next = next ? std::min(next, start) : start;
+		}
+	}
+
+	if (next == this->armed) {
+		return;
+	}
+	this->armed = next;
+
+	// all zero disarms it
+	itimerspec spec{};
+	spec.it_value.tv_sec = next / 1000;
+	spec.it_value.tv_nsec = (next % 1000) * 1000000;
+	timerfd_settime(this->timerfd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+} // namespace xautocfg
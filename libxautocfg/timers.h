@@ -0,0 +1,121 @@
+/**
+ * timers on a single timerfd.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+namespace xautocfg {
+
+/**
+ * hierarchical timer wheel with millisecond resolution.
+ *
+ * there are 6 levels of 64 slots, a timer is in the level of the
+ * highest 6 bit group in which its deadline differs from the wheel time.
+ * slots are intrusive lists, so adding and cancelling is O(1).
+ * when the wheel time passes a slot of a higher level,
+ * its timers move down or expire.
+ *
+ * one timerfd is armed for the start of the next occupied slot
+ * and disarmed when there are no timers, so nothing wakes up while idle.
+ */
+class timer_wheel {
+public:
+	using callback = std::function<void()>;
+
+	/**
+	 * refers to a timer, stays valid but inert once the timer is gone.
+	 */
+	struct handle {
+		uint32_t index = none;
+		uint32_t generation = 0;
+	};
+
+	timer_wheel();
+	~timer_wheel();
+
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel &operator =(const timer_wheel &) = delete;
+
+	/**
+	 * readable when timers have expired, then call dispatch().
+	 */
+	int fd() const {
+		return this->timerfd;
+	}
+
+	/**
+	 * call func once after delay.
+	 */
+	handle add(std::chrono::milliseconds delay, callback func);
+
+	/**
+	 * stop a timer, does nothing if it already fired.
+	 */
+	void cancel(handle &timer);
+
+	bool active(const handle &timer) const;
+
+	/**
+	 * run the callbacks of all expired timers.
+	 * they may add and cancel timers.
+	 */
+	void dispatch();
+
+private:
+	static constexpr uint32_t none = UINT32_MAX;
+	static constexpr int level_bits = 6;
+	static constexpr int levels = 6;
+	static constexpr int slots = 1 << level_bits;
+	// the list of timers that expire at the next dispatch()
+	static constexpr uint32_t expired = levels * slots;
+
+	struct node {
+		uint64_t deadline = 0;
+		callback func;
+		uint32_t prev = none;
+		uint32_t next = none;
+		uint32_t list = none;
+		uint32_t generation = 0;
+	};
+
+	static uint64_t now();
+
+	void link(uint32_t idx);
+	void unlink(uint32_t idx);
+	void release(uint32_t idx);
+
+	/**
+	 * advance the wheel time, moving timers from passed slots.
+	 */
+	void advance(uint64_t to);
+
+	/**
+	 * arm the timerfd for the next slot that needs attention.
+	 */
+	void rearm();
+
+	int timerfd = -1;
+	// wheel time, in milliseconds of CLOCK_MONOTONIC
+	uint64_t current;
+	uint64_t armed = 0;
+	size_t count = 0;
+
+	std::vector<node> nodes;
+	uint32_t free_list = none;
+	std::array<uint32_t, expired + 1> heads;
+	// occupied slots of each level
+	std::array<uint64_t, levels> occupied{};
+};
+
+} // namespace xautocfg
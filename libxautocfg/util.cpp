@@ -0,0 +1,120 @@
+/**
+ * small helpers for files, processes and hashing.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include "util.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+#include "log.h"
+
+namespace xautocfg {
+
+uint64_t fnv1a(std::string_view data, uint64_t hash) {
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+
+std::optional<std::string> read_file(const std::string &path) {
+	std::ifstream file{path, std::ios::binary};
+	if (not file.is_open()) {
+		return std::nullopt;
+	}
+	std::ostringstream content;
+	content << file.rdbuf();
+	return std::move(content).str();
+}
+
+
+std::optional<std::string> exec_read(const std::vector<std::string> &argv) {
+	int pipefd[2];
+	if (pipe(pipefd) == -1) {
+		log_error() << "failed to create pipe: " << std::strerror(errno);
+		return std::nullopt;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		log_error() << "failed to fork for " << argv[0];
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return std::nullopt;
+	}
+	else if (pid == 0) {
+		close(pipefd[0]);
+		dup2(pipefd[1], STDOUT_FILENO);
+		close(pipefd[1]);
+
+		std::vector<char *> args;
+		for (auto &arg : argv) {
+			args.push_back(const_cast<char *>(arg.c_str()));
+		}
+		args.push_back(nullptr);
+		execvp(args[0], args.data());
+		perror("failed to execute");
+		_exit(127);
+	}
+
+	close(pipefd[1]);
+	std::string output;
+	char buf[4096];
+	ssize_t len;
+	while ((len = read(pipefd[0], buf, sizeof(buf))) != 0) {
+		if (len == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		output.append(buf, len);
+	}
+	close(pipefd[0]);
+
+	int status;
+	waitpid(pid, &status, 0);
+	if (not WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+		return std::nullopt;
+	}
+	return output;
+}
+
+
+std::string xdg_path(const char *env, const char *fallback, const std::string &name) {
+	const char *base = std::getenv(env);
+	if (base and *base) {
+		return std::format("{}/xautocfg/{}", base, name);
+	}
+	const char *home = std::getenv("HOME");
+	if (not home) {
+		return "";
+	}
+	return std::format("{}/{}/xautocfg/{}", home, fallback, name);
+}
+
+
+std::string expand_home(const std::string& path) {
+	const char *home = std::getenv("HOME");
+	if (home and path.starts_with("~/")) {
+		return std::string{home} + path.substr(1);
+	}
+	return path;
+}
+
+} // namespace xautocfg
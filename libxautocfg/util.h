@@ -0,0 +1,48 @@
+/**
+ * small helpers for files, processes and hashing.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace xautocfg {
+
+/**
+ * 64 bit fnv-1a hash, to detect content changes.
+ * pass the previous hash to hash several parts.
+ */
+uint64_t fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325);
+
+/**
+ * whole content of a file, nullopt if it can't be opened.
+ */
+std::optional<std::string> read_file(const std::string &path);
+
+/**
+ * read all output of a child process until it exits.
+ * returns nullopt if it failed.
+ */
+std::optional<std::string> exec_read(const std::vector<std::string> &argv);
+
+/**
+ * path of a file below an xdg base directory.
+ * env is the variable to check, fallback the directory below $HOME.
+ */
+std::string xdg_path(const char *env, const char *fallback, const std::string &name);
+
+/**
+ * replace a leading ~/ with $HOME.
+ */
+std::string expand_home(const std::string& path);
+
+} // namespace xautocfg
@@ -0,0 +1,209 @@
+/**
+ * libxautocfg: apply an xautocfg config to an X display
+ * from within another program.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <X11/Xlib.h>
+
+#include "config.h"
+#include "log.h"
+
+
+namespace xautocfg {
+
+/**
+ * the config shared by instances, e.g. one per display.
+ *
+ * each published config is an immutable snapshot.
+ * the snapshot pointer is a std::atomic<std::shared_ptr>, which isn't
+ * lock-free in libstdc++: current() and publish() take its internal lock
+ * for the copy or swap of the pointer. a reader never waits for more,
+ * parsing happens before and waking the instances after it.
+ * instances switch to a new snapshot in their next dispatch(),
+ * the old one is freed when the last instance has let go of it.
+ */
+class config_source {
+public:
+	explicit config_source(config cfg);
+
+	config_source(const config_source &) = delete;
+	config_source &operator =(const config_source &) = delete;
+
+	std::shared_ptr<const config> current() const;
+
+	/**
+	 * replace the config, instances are woken up through their fd().
+	 * may be called from any thread.
+	 */
+	void publish(config cfg);
+
+	/**
+	 * make an eventfd readable on each publish().
+	 */
+	void add_listener(int eventfd);
+	void remove_listener(int eventfd);
+
+private:
+	std::atomic<std::shared_ptr<const config>> snapshot;
+
+	// only taken by publishers and (un)registering instances
+	std::mutex listeners_lock;
+	std::vector<int> listeners;
+};
+
+
+/**
+ * parsed configs, shared by all displays of a user.
+ *
+ * a source is found by the user id and the list of files. the files are
+ * only parsed again when one of them changed (device, inode, size or
+ * modification time), so many sessions of one user parse them once.
+ */
+class config_cache {
+public:
+	/**
+	 * the source for these config files, parsed if they changed since.
+	 * with required, layers is a single file that has to exist.
+	 * throws std::runtime_error for invalid files the first time,
+	 * later a broken file keeps the previous config like reload().
+	 */
+	std::shared_ptr<config_source> get(uid_t uid, const std::vector<std::string> &layers,
+	                                   bool required = false);
+
+	/**
+	 * parse changed files again and publish them to their source.
+	 * a broken file keeps the previous config of that source.
+	 * returns how many sources got a new config.
+	 */
+	size_t reload();
+
+private:
+	struct entry {
+		uid_t uid;
+		std::vector<std::string> layers;
+		bool required;
+		std::string version;
+		std::shared_ptr<config_source> source;
+	};
+
+	static std::string version(const std::vector<std::string> &layers);
+	static config parse(const entry &entry);
+
+	std::vector<entry> entries;
+};
+
+
+/**
+ * the config files of the user running this, system ones first:
+ * xautocfg.cfg in each of $XDG_CONFIG_DIRS (/etc/xdg),
+ * then in $XDG_CONFIG_HOME (~/.config).
+ */
+std::vector<std::string> config_layers();
+
+
+/**
+ * keeps a config applied to one X display.
+ *
+ * the instance has no event loop of its own.
+ * wait until fd() is readable or timeout() milliseconds have passed,
+ * then call dispatch().
+ * it doesn't install signal handlers, hooks are reaped through pidfds.
+ * timers are on the fd too, while idle nothing wakes it up.
+ */
+class instance {
+public:
+	struct options {
+		// display to connect to, nullptr for $DISPLAY
+		const char *display = nullptr;
+		// follow hotplug and focus changes.
+		// if false, the settings are applied once to the present devices.
+		bool watch = true;
+		// install an xlib error handler that logs errors instead of exiting.
+		// it's process-wide and replaces the one of the host program,
+		// which then has to cope with errors for devices that are already gone.
+		bool log_x_errors = false;
+	};
+
+	/**
+	 * connect to the display and apply the session settings,
+	 * resources and keyboard settings to all present devices.
+	 * listing the devices, the lock state and the keymap of each keyboard
+	 * with remaps take a round trip each. the settings themselves
+	 * are not waited for, call sync() for that.
+	 * throws std::runtime_error if the display can't be used.
+	 */
+	instance(config cfg, const options &opts);
+	explicit instance(config cfg);
+
+	/**
+	 * follow the snapshots of a shared config.
+	 */
+	instance(std::shared_ptr<config_source> source, const options &opts);
+	~instance();
+
+	instance(const instance &) = delete;
+	instance &operator =(const instance &) = delete;
+
+	/**
+	 * file descriptor to poll for reading.
+	 * it stays the same for the lifetime of the instance.
+	 */
+	int fd() const;
+
+	/**
+	 * milliseconds until dispatch() has to be called even if fd() isn't readable,
+	 * -1 for no limit.
+	 */
+	int timeout() const;
+
+	/**
+	 * process everything that is ready, never blocks.
+	 */
+	void dispatch();
+
+	/**
+	 * wait until the X server has processed all requests.
+	 */
+	void sync();
+
+	/**
+	 * report running and failed hooks.
+	 */
+	void print_status(std::ostream &out) const;
+
+	Display *display() const;
+
+	/**
+	 * the snapshot this instance currently applies.
+	 */
+	std::shared_ptr<const config> get_config() const;
+
+private:
+	struct state;
+	std::unique_ptr<state> impl;
+};
+
+
+/**
+ * write the xkb controls and xinput properties of all devices
+ * and the core server settings as json, for bug reports.
+ * display is null for $DISPLAY.
+ */
+void dump_state(const char *display, std::ostream &out);
+
+} // namespace xautocfg
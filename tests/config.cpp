@@ -0,0 +1,96 @@
+/**
+ * checks of reloading configs.
+ * a broken file has to keep the previous config, whatever the error is.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "xautocfg.h"
+
+using namespace xautocfg;
+
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+	if (not ok) {
+		std::cerr << "FAIL: " << what << std::endl;
+		failures++;
+	}
+}
+
+
+void write_file(const std::string &path, const std::string &content) {
+	std::ofstream file{path, std::ios::trunc};
+	file << content;
+}
+
+
+/**
+ * reload a file after breaking it,
+ * the error has to name the file and line.
+ */
+void reload_broken(const std::string &path, const std::string &broken) {
+	write_file(path, "[keyboard]\nrate = 40\n");
+	config_cache configs;
+	auto source = configs.get(getuid(), {path}, true);
+	auto before = source->current();
+	check(before->keyboard.interval == 25, "the valid config is loaded");
+
+	std::string errors;
+	set_log_handler([&](log_level level, std::string_view message) {
+		if (level == log_level::error) {
+			errors += message;
+			errors += '\n';
+		}
+	});
+
+	write_file(path, broken);
+	check(configs.reload() == 0, "a broken config is not published: " + broken);
+	check(source->current() == before, "the previous config is kept: " + broken);
+	check(errors.find(path) != std::string::npos and errors.find("line 5") != std::string::npos,
+	      "the error names the file and line: " + errors);
+
+	// fixed again, it's picked up
+	write_file(path, "[keyboard]\nrate = 50\n");
+	check(configs.reload() == 1, "a fixed config is published: " + broken);
+	check(source->current()->keyboard.interval == 20, "the fixed config is used: " + broken);
+
+	set_log_handler({});
+}
+
+
+int main() {
+	char dir[] = "/tmp/xautocfg-test-XXXXXX";
+	if (not mkdtemp(dir)) {
+		perror("failed to create a directory");
+		return 1;
+	}
+	std::string path = std::string{dir} + "/xautocfg.cfg";
+
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[keyboard.x]\nrate = abc\nmatch = x\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[keyboard.x]\nfoo = 1\nmatch = x\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[application.x]\ndelay = fast\nmatch = x\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[session]\nscreensaver = 40000\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[session]\nscreensaver_cycle = -5\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[session]\ndpms = 600 900 70000\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[session]\ndpms = 600 -1 1200\n");
+	reload_broken(path, "[keyboard]\nrate = 40\n\n[session]\ndpms = 600 900 1200 5\n");
+
+	unlink(path.c_str());
+	rmdir(dir);
+
+	if (failures) {
+		return 1;
+	}
+	std::cout << "config: ok" << std::endl;
+	return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * checks of the gamma ramps.
+ * every vectorized path has to give exactly the ramp of the scalar one.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gamma.h"
+
+using namespace xautocfg;
+
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+	if (not ok) {
+		std::cerr << "FAIL: " << what << std::endl;
+		failures++;
+	}
+}
+
+
+using path = size_t (*)(uint16_t *, size_t, size_t, float);
+
+/**
+ * a ramp filled by a path and the scalar rest.
+ */
+std::vector<uint16_t> fill_with(path fill, size_t size, float top) {
+	std::vector<uint16_t> ramp(size);
+	float step = gamma_ramp::step(size, top);
+	size_t done = fill(ramp.data(), 0, size, step);
+	gamma_ramp::fill_scalar(ramp.data(), done, size, step);
+	return ramp;
+}
+
+
+void compare(size_t size, float top) {
+	std::vector<uint16_t> scalar = fill_with(gamma_ramp::fill_scalar, size, top);
+
+	std::vector<uint16_t> ramp(size);
+	fill_ramp(ramp.data(), size, top);
+	check(ramp == scalar, std::format("fill_ramp differs from scalar, size {} top {}", size, top));
+
+#if defined(__SSE2__)
+	check(fill_with(gamma_ramp::fill_sse2, size, top) == scalar,
+	      std::format("sse2 differs from scalar, size {} top {}", size, top));
+#endif
+#if defined(__AVX2__)
+	check(fill_with(gamma_ramp::fill_avx2, size, top) == scalar,
+	      std::format("avx2 differs from scalar, size {} top {}", size, top));
+#endif
+
+	if (size > 1) {
+		float clamped = std::fmin(std::fmax(top, 0.f), 1.f);
+		check(scalar[0] == 0, std::format("ramp doesn't start at 0, size {} top {}", size, top));
+		check(std::abs(scalar[size - 1] - std::lround(clamped * 65535)) <= 1,
+		      std::format("ramp ends at {}, size {} top {}", scalar[size - 1], size, top));
+	}
+}
+
+
+int main() {
+	for (size_t size : {0, 1, 2, 7, 8, 9, 15, 16, 17, 31, 255, 256, 1024, 4096, 65536}) {
+		for (float top : {-1.f, 0.f, 0.1f, 0.5f, 0.73f, 0.999f, 1.f, 1.5f}) {
+			compare(size, top);
+		}
+	}
+
+	if (failures) {
+		return 1;
+	}
+	std::cout << "gamma: ok" << std::endl;
+	return 0;
+}
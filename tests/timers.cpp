@@ -0,0 +1,123 @@
+/**
+ * checks of the timer wheel.
+ * the timerfd has to be disarmed once no timer is left,
+ * otherwise the event loop keeps waking up for nothing.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <poll.h>
+#include <sys/timerfd.h>
+
+#include "timers.h"
+
+using namespace xautocfg;
+using namespace std::literals;
+
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+	if (not ok) {
+		std::cerr << "FAIL: " << what << std::endl;
+		failures++;
+	}
+}
+
+
+bool disarmed(const timer_wheel &timers) {
+	itimerspec spec;
+	if (timerfd_gettime(timers.fd(), &spec) != 0) {
+		return false;
+	}
+	return spec.it_value.tv_sec == 0 and spec.it_value.tv_nsec == 0;
+}
+
+
+/**
+ * dispatch until done is set, false if that takes too long.
+ */
+bool run_until(timer_wheel &timers, const bool &done) {
+	for (int i = 0; i < 100 and not done; i++) {
+		pollfd pfd{timers.fd(), POLLIN, 0};
+		poll(&pfd, 1, 100);
+		timers.dispatch();
+	}
+	return done;
+}
+
+
+void cancel_last() {
+	timer_wheel timers;
+	check(disarmed(timers), "a new wheel is disarmed");
+
+	auto near = timers.add(100ms, [] {});
+	auto far = timers.add(1h, [] {});
+	check(not disarmed(timers), "armed with timers");
+
+	timers.cancel(near);
+	check(not disarmed(timers), "still armed while a timer is left");
+	timers.cancel(far);
+	check(disarmed(timers), "disarmed after the last timer was cancelled");
+
+	// cancelling again changes nothing
+	timers.cancel(far);
+	check(disarmed(timers), "disarmed after cancelling a gone timer");
+}
+
+
+void fire_last() {
+	timer_wheel timers;
+	bool fired = false;
+	timers.add(10ms, [&] { fired = true; });
+
+	check(run_until(timers, fired), "the timer fired");
+	check(disarmed(timers), "disarmed after the last timer fired");
+}
+
+
+void fire_and_cancel_other() {
+	timer_wheel timers;
+	bool fired = false;
+	auto other = timers.add(1h, [] {});
+	timers.add(10ms, [&] {
+		fired = true;
+		timers.cancel(other);
+	});
+
+	check(run_until(timers, fired), "the timer fired");
+	check(disarmed(timers), "disarmed after a callback cancelled the last timer");
+}
+
+
+void fire_and_add() {
+	timer_wheel timers;
+	bool first = false, second = false;
+	timers.add(10ms, [&] {
+		first = true;
+		timers.add(10ms, [&] { second = true; });
+	});
+
+	check(run_until(timers, first), "the first timer fired");
+	check(not disarmed(timers), "armed for a timer added by a callback");
+	check(run_until(timers, second), "the timer added by a callback fired");
+	check(disarmed(timers), "disarmed after the added timer fired");
+}
+
+
+int main() {
+	cancel_last();
+	fire_last();
+	fire_and_cancel_other();
+	fire_and_add();
+
+	if (failures) {
+		return 1;
+	}
+	std::cout << "timers: ok" << std::endl;
+	return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * build the quirk database for the [quirks] section of xautocfg.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <quirks.h>
+
+using namespace xautocfg;
+
+
+/**
+ * read quirk source files:
+ *
+ *   # comment
+ *   [046d:c52b 046d:c534]
+ *   delay = 300
+ *   bounce_keys = 30
+ *
+ * a section lists vendor:product ids in hex and contains [keyboard] entries.
+ * every entry is checked, so the daemon never sees an invalid one.
+ */
+void parse_quirks(const std::string &path, std::map<uint64_t, std::string> *entries) {
+	std::ifstream file{path, std::ios::binary};
+	if (not file.is_open()) {
+		throw std::runtime_error{std::format("failed to open '{}'", path)};
+	}
+
+	const std::regex comment_re("^ *([^#]*) *#?.*");
+	const std::regex section_re("^\\[([^\\]]+)\\]$");
+	const std::regex kv_re("^([^= ]+) *= *(.+)$");
+	const std::regex id_re("^([0-9a-fA-F]{1,8}):([0-9a-fA-F]{1,8})$");
+
+	std::vector<uint64_t> keys;
+	std::string text;
+	auto store = [&] {
+		for (uint64_t key : keys) {
+			entries->insert_or_assign(key, text);
+		}
+	};
+
+	std::string fullline;
+	int linenr = 0;
+	while (std::getline(file, fullline)) {
+		linenr += 1;
+		auto error = [&](const std::string &what) {
+			return std::runtime_error{std::format("{} line {}: {}\n{}", path, linenr, what, fullline)};
+		};
+
+		std::smatch comment_match;
+		std::regex_match(fullline, comment_match, comment_re);
+		std::string line = comment_match.ready() and comment_match.size() == 2 ? comment_match[1].str() : "";
+		while (not line.empty() and line.back() == ' ') {
+			line.pop_back();
+		}
+		if (line.empty()) {
+			continue;
+		}
+
+		std::smatch match;
+		if (std::regex_match(line, match, section_re)) {
+			store();
+			keys.clear();
+			text.clear();
+
+			std::istringstream ids{match[1].str()};
+			for (std::string id; ids >> id;) {
+				std::smatch id_match;
+				if (not std::regex_match(id, id_match, id_re)) {
+					throw error(std::format("expected vendor:product, got: {}", id));
+				}
+				uint64_t key = quirk_db::key(std::stoul(id_match[1], nullptr, 16),
+				                             std::stoul(id_match[2], nullptr, 16));
+				if (entries->contains(key) or std::ranges::find(keys, key) != keys.end()) {
+					throw error(std::format("duplicate device {}", id));
+				}
+				keys.push_back(key);
+			}
+			continue;
+		}
+
+		if (std::regex_match(line, match, kv_re)) {
+			if (keys.empty()) {
+				throw error("entry outside of a device section");
+			}
+
+			struct config::keyboard kbd;
+			try {
+				quirk_db::parse_entry(&kbd, match[1], match[2]);
+			}
+			catch (std::logic_error &err) {
+				throw error(err.what());
+			}
+			text += std::format("{} = {}\n", match[1].str(), match[2].str());
+			continue;
+		}
+
+		throw error("invalid syntax");
+	}
+	store();
+}
+
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " SOURCE... OUTPUT\n"
+		          << "\n"
+		          << "build a quirk database for the [quirks] section of xautocfg.cfg."
+		          << std::endl;
+		return 1;
+	}
+
+	std::map<uint64_t, std::string> entries;
+	std::string content;
+	try {
+		for (int i = 1; i < argc - 1; i++) {
+			parse_quirks(argv[i], &entries);
+		}
+		content = quirk_db::build(entries);
+	}
+	catch (std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+
+	// replace atomically, the daemon may have the old one mapped
+	std::string output = argv[argc - 1];
+	std::string tmppath = output + ".tmp";
+	{
+		std::ofstream file{tmppath, std::ios::binary | std::ios::trunc};
+		file.write(content.data(), content.size());
+		if (not file) {
+			std::cerr << "failed to write " << tmppath << std::endl;
+			std::remove(tmppath.c_str());
+			return 1;
+		}
+	}
+	if (std::rename(tmppath.c_str(), output.c_str()) != 0) {
+		perror("failed to replace quirk database");
+		return 1;
+	}
+
+	std::cout << "wrote " << entries.size() << " devices to " << output << std::endl;
+	return 0;
+}
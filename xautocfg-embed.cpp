@@ -0,0 +1,275 @@
+/**
+ * turn an xautocfg config file into a header,
+ * to build it into the binary with make EMBED_CONFIG=file.
+ *
+ * (c) 2022-2024 Jonas Jelten <jj@sft.lol>
+ *
+ * GPLv3 or later.
+ */
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <X11/Xlib.h>
+
+#include <xautocfg.h>
+
+using namespace xautocfg;
+
+
+/**
+ * c++ string literal for any content.
+ */
+std::string quote(std::string_view str) {
+	std::string ret = "\"";
+	for (unsigned char c : str) {
+		if (c == '"' or c == '\\') {
+			ret += '\\';
+			ret += c;
+		}
+		else if (c >= 0x20 and c < 0x7f) {
+			ret += c;
+		}
+		else {
+			// always three digits, so following digits aren't taken as part of it
+			ret += std::format("\\{:03o}", c);
+		}
+	}
+	ret += '"';
+	return ret;
+}
+
+
+const char *lock_mode_name(lock_mode mode) {
+	switch (mode) {
+	case lock_mode::keep: return "lock_mode::keep";
+	case lock_mode::sync: return "lock_mode::sync";
+	case lock_mode::on:   return "lock_mode::on";
+	case lock_mode::off:  return "lock_mode::off";
+	}
+	return "lock_mode::keep";
+}
+
+
+void emit_hooks(std::ostream &out, const std::string &name, const hook_set &hooks) {
+	for (auto &hook : hooks.hooks) {
+		out << "\t" << name << ".hooks.push_back({.name = " << quote(hook.name)
+		    << ", .command = " << quote(hook.command)
+		    << ", .vars = " << hook.vars << ", .after = {";
+		for (size_t i = 0; i < hook.after.size(); i++) {
+			out << (i ? ", " : "") << quote(hook.after[i]);
+		}
+		out << "}});\n";
+	}
+	if (hooks.memoize.enabled) {
+		out << "\t" << name << ".memoize.enabled = true;\n"
+		    << "\t" << name << ".memoize.ttl = std::chrono::seconds{" << hooks.memoize.ttl.count() << "};\n";
+	}
+}
+
+
+void emit_keyboard(std::ostream &out, const std::string &name, const struct config::keyboard &kbd) {
+	out << "\t" << name << ".delay = " << kbd.delay << ";\n"
+	    << "\t" << name << ".interval = " << kbd.interval << ";\n"
+	    << "\t" << name << ".rule = " << quote(kbd.rule) << ";\n";
+
+	emit_hooks(out, name + ".on_connect", kbd.on_connect);
+	emit_hooks(out, name + ".on_disconnect", kbd.on_disconnect);
+	if (kbd.hook_timeout.count()) {
+		out << "\t" << name << ".hook_timeout = std::chrono::seconds{" << kbd.hook_timeout.count() << "};\n";
+	}
+
+	for (auto &remap : kbd.remaps) {
+		const char *from = XKeysymToString(remap.from);
+		const char *to = XKeysymToString(remap.to);
+		out << "\t" << name << ".remaps.push_back({" << std::format("{:#x}, {:#x}", remap.from, remap.to)
+		    << "});  // " << (from ? from : "?") << " " << (to ? to : "?") << "\n";
+	}
+
+	const xkb_controls &ctrls = kbd.controls;
+	out << "\t" << name << ".controls.affect_enabled = " << std::format("{:#x}", ctrls.affect_enabled) << ";\n"
+	    << "\t" << name << ".controls.enabled = " << std::format("{:#x}", ctrls.enabled) << ";\n"
+	    << "\t" << name << ".controls.change = " << std::format("{:#x}", ctrls.change) << ";\n"
+	    << "\t" << name << ".controls.slow_keys_delay = " << ctrls.slow_keys_delay << ";\n"
+	    << "\t" << name << ".controls.debounce_delay = " << ctrls.debounce_delay << ";\n"
+	    << "\t" << name << ".controls.ignore_lock_mods = " << static_cast<int>(ctrls.ignore_lock_mods) << ";\n";
+	if (ctrls.change & XkbPerKeyRepeatMask) {
+		out << "\t" << name << ".controls.per_key_repeat = {{";
+		for (size_t i = 0; i < ctrls.per_key_repeat.size(); i++) {
+			out << (i ? ", " : "") << std::format("{:#04x}", ctrls.per_key_repeat[i]);
+		}
+		out << "}};\n";
+	}
+
+	out << "\t" << name << ".capslock = " << lock_mode_name(kbd.capslock) << ";\n"
+	    << "\t" << name << ".numlock = " << lock_mode_name(kbd.numlock) << ";\n";
+}
+
+
+void emit_session(std::ostream &out, const session_settings &session) {
+	auto emit_int = [&](const char *name, const std::optional<int> &val) {
+		if (val) {
+			out << "\tcfg.session." << name << " = " << *val << ";\n";
+		}
+	};
+	emit_int("bell_percent", session.bell_percent);
+	emit_int("bell_pitch", session.bell_pitch);
+	emit_int("bell_duration", session.bell_duration);
+	emit_int("screensaver_timeout", session.screensaver_timeout);
+	emit_int("screensaver_cycle", session.screensaver_cycle);
+
+	if (session.dpms) {
+		if (auto &timeouts = *session.dpms) {
+			out << "\tcfg.session.dpms = std::optional<std::array<uint16_t, 3>>{{"
+			    << (*timeouts)[0] << ", " << (*timeouts)[1] << ", " << (*timeouts)[2] << "}};\n";
+		}
+		else {
+			out << "\tcfg.session.dpms = std::optional<std::array<uint16_t, 3>>{};\n";
+		}
+	}
+
+	if (session.pointer_accel) {
+		out << "\tcfg.session.pointer_accel = std::pair{" << session.pointer_accel->first
+		    << ", " << session.pointer_accel->second << "};\n";
+	}
+	emit_int("pointer_threshold", session.pointer_threshold);
+}
+
+
+std::string color_settings_init(const color_settings &color) {
+	return std::format("color_settings{{.temperature = {}, .night_temperature = {}, "
+	                   ".brightness = {}, .night_brightness = {}}}",
+	                   color.temperature, color.night_temperature,
+	                   color.brightness, color.night_brightness);
+}
+
+
+/**
+ * write a function that builds the config without reading or parsing anything.
+ * only the regexes are still compiled at startup, std::regex can't be constexpr.
+ * ~/ in paths is expanded then too, for the home of whoever runs it.
+ */
+void emit_config(std::ostream &out, const std::string &source, const config &cfg) {
+	out << "// generated by xautocfg-embed from " << source << ", do not edit.\n"
+	    << "\n"
+	    << "#pragma once\n"
+	    << "\n"
+	    << "#include <array>\n"
+	    << "#include <chrono>\n"
+	    << "#include <optional>\n"
+	    << "#include <regex>\n"
+	    << "#include <utility>\n"
+	    << "\n"
+	    << "#include <xautocfg.h>\n"
+	    << "#include <util.h>\n"
+	    << "\n"
+	    << "\n"
+	    << "namespace xautocfg {\n"
+	    << "\n"
+	    << "inline config embedded_config() {\n"
+	    << "\tconfig cfg;\n";
+
+	emit_keyboard(out, "cfg.keyboard", cfg.keyboard);
+
+	// paths below ~ are for the home of the user running it, not the one building it
+	for (auto &file : cfg.resources.files) {
+		out << "\tcfg.resources.files.push_back(expand_home(" << quote(file) << "));\n";
+	}
+	out << "\tcfg.resources.cpp = " << quote(cfg.resources.cpp) << ";\n"
+	    << "\tcfg.resources.dpi = " << (cfg.resources.dpi ? "true" : "false") << ";\n"
+	    << "\tcfg.resources.cursor_size = " << cfg.resources.cursor_size << ";\n";
+
+	emit_session(out, cfg.session);
+
+	if (not cfg.quirks_db.empty()) {
+		out << "\tcfg.quirks_db = expand_home(" << quote(cfg.quirks_db) << ");\n";
+	}
+	out << "\tcfg.hooks.jobs = " << cfg.hooks.jobs << ";\n"
+	    << "\tcfg.hooks.queue = " << cfg.hooks.queue << ";\n"
+	    << "\tcfg.hooks.shed = " << (cfg.hooks.shed == shed_policy::newest ? "shed_policy::newest" : "shed_policy::oldest") << ";\n";
+
+	if (cfg.color.enabled) {
+		out << "\tcfg.color.enabled = true;\n"
+		    << "\tcfg.color.settings = " << color_settings_init(cfg.color.settings) << ";\n"
+		    << "\tcfg.color.dusk = " << cfg.color.dusk << ";\n"
+		    << "\tcfg.color.dawn = " << cfg.color.dawn << ";\n"
+		    << "\tcfg.color.fade = " << cfg.color.fade << ";\n";
+		for (auto &output : cfg.color.outputs) {
+			out << "\tcfg.color.outputs.push_back({" << quote(output.name) << ", "
+			    << color_settings_init(output.settings) << ", {}});\n";
+		}
+	}
+
+	for (auto &rule : cfg.device_rules) {
+		out << "\t{\n"
+		    << "\tauto &rule = cfg.device_rules.emplace_back();\n"
+		    << "\trule.name = " << quote(rule.name) << ";\n";
+		if (rule.match) {
+			out << "\trule.match_src = " << quote(rule.match_src) << ";\n"
+			    << "\trule.match = std::regex{rule.match_src, std::regex::optimize};\n";
+		}
+		if (rule.master) {
+			out << "\trule.master_src = " << quote(rule.master_src) << ";\n"
+			    << "\trule.master = std::regex{rule.master_src, std::regex::optimize};\n";
+		}
+		emit_keyboard(out, "rule.keyboard", rule.keyboard);
+		out << "\t}\n";
+	}
+
+	for (auto &profile : cfg.app_profiles) {
+		out << "\t{\n"
+		    << "\tauto &profile = cfg.app_profiles.emplace_back();\n"
+		    << "\tprofile.name = " << quote(profile.name) << ";\n"
+		    << "\tprofile.match_src = " << quote(profile.match_src) << ";\n"
+		    << "\tprofile.match = std::regex{profile.match_src, std::regex::optimize};\n"
+		    << "\tprofile.delay = " << profile.delay << ";\n"
+		    << "\tprofile.interval = " << profile.interval << ";\n"
+		    << "\t}\n";
+	}
+
+	out << "\treturn cfg;\n"
+	    << "}\n"
+	    << "\n"
+	    << "} // namespace xautocfg\n";
+}
+
+
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		std::cout << "usage: " << argv[0] << " CONFIG OUTPUT\n"
+		          << "\n"
+		          << "write a header with the config built in, for make EMBED_CONFIG=CONFIG."
+		          << std::endl;
+		return 1;
+	}
+
+	// keep ~/ in paths, they are expanded when the binary starts
+	setenv("HOME", "~", 1);
+
+	config cfg;
+	try {
+		cfg = parse_config(argv[1]);
+	}
+	catch (std::exception &err) {
+		std::cerr << argv[1] << ": " << err.what() << std::endl;
+		return 1;
+	}
+
+	std::ofstream out{argv[2], std::ios::trunc};
+	emit_config(out, argv[1], cfg);
+	out.close();
+	if (not out) {
+		std::cerr << "failed to write " << argv[2] << std::endl;
+		std::remove(argv[2]);
+		return 1;
+	}
+	return 0;
+}
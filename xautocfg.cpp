@@ -7,33 +7,48 @@
  */
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
 #include <format>
-#include <fstream>
 #include <getopt.h>
+#include <grp.h>
 #include <iostream>
+#include <map>
 #include <memory>
-#include <regex>
-#include <stdexcept>
+#include <optional>
+#include <pwd.h>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <poll.h>
 #include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 
-#include <X11/XKBlib.h>
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
-#include <X11/extensions/XI2.h>
-#include <X11/extensions/XInput2.h>
-#include <X11/extensions/XKB.h>
+#include <xautocfg.h>
 
-using namespace std::literals;
+#ifdef XAUTOCFG_EMBEDDED_CONFIG
+#include "embedded_config.h"
+#endif
 
 
 struct args {
 	std::string config;
 	bool custom_config = false;
+	std::vector<std::string> displays;
+	bool oneshot = false;
+	bool dump = false;
 };
 
 
@@ -47,23 +62,31 @@ args parse_args(int argc, char** argv) {
 		static struct option long_options[] = {
 			{"help",    no_argument,       0, 'h'},
 			{"config",  required_argument, 0, 'c'},
+			{"display", required_argument, 0, 'd'},
+			{"oneshot", no_argument,       0, '1'},
 			{0,         0,                 0,  0 }
 		};
 
-		c = getopt_long(argc, argv, "c:h",
+		c = getopt_long(argc, argv, "c:d:h1",
 		                long_options, &option_index);
 		if (c == -1)
 			break;
 
 		switch (c) {
 		case 'h': {
-			std::cout << "usage: " << argv[0] << " [OPTION]...\n"
+			std::cout << "usage: " << argv[0] << " [OPTION]... [dump]\n"
 			          << "\n"
 			          << "automatically set properties for newly connected X devices.\n"
 			          << "\n"
 			          << "Options:\n"
 			          << "   -h, --help                 show this help\n"
-			          << "   -c, --config=FILE          use this config file instead of ~/.config/xautocfg.cfg\n"
+			          << "   -c, --config=FILE          use this config file instead of /etc/xdg/xautocfg.cfg\n"
+			          << "                              and ~/.config/xautocfg.cfg\n"
+			          << "   -d, --display=DISPLAY      serve this display instead of $DISPLAY, can be repeated\n"
+			          << "   -1, --oneshot              apply settings to all present devices and exit\n"
+			          << "\n"
+			          << "Commands:\n"
+			          << "   dump                       print the state of all input devices as json and exit\n"
 			          << std::endl;
 
 			const option *op = nullptr;
@@ -78,296 +101,420 @@ args parse_args(int argc, char** argv) {
 		}
 
 		case 'c':
+#ifdef XAUTOCFG_EMBEDDED_CONFIG
+			std::cout << "the config is built into this binary" << std::endl;
+			exit(1);
+#endif
 			ret.config = std::string{optarg};
 			ret.custom_config = true;
 			break;
+
+		case 'd':
+			ret.displays.emplace_back(optarg);
+			break;
+
+		case '1':
+			ret.oneshot = true;
+			break;
 		}
 	}
 
+	if (optind < argc and std::string_view{argv[optind]} == "dump") {
+		ret.dump = true;
+		optind++;
+	}
+
 	if (optind < argc) {
 		std::cout << "invalid non-option arguments" << std::endl;
 		exit(1);
 	}
 
-	// set defaults
-	if (not ret.config.size()) {
-		std::ostringstream cfgpathss;
-		const char *home = std::getenv("HOME");
-		if (not home) {
-			std::cout << "HOME env not set, can't locate config." << std::endl;
-			exit(1);
-		}
-		cfgpathss << home << "/.config/xautocfg.cfg";
-		ret.config = std::move(cfgpathss).str();
-	}
-
 	return ret;
 }
 
 
-struct config {
-	struct keyboard {
-		uint32_t delay = 200;
-		uint32_t interval = 20;
-		std::string on_connect = "";
-		std::string on_disconnect = "";
-	} keyboard;
-};
-
-enum class config_section {
-	none,
-	keyboard,
-};
-
-
-void parse_config_entry(config *config,
-                        config_section section,
-                        const std::string& key,
-                        const std::string& val) {
-	std::istringstream vals{val};
-
-	switch (section) {
-	case config_section::keyboard:
-		if (key == "delay"sv) {
-			vals >> config->keyboard.delay;
-		}
-		else if (key == "rate"sv) {
-			uint32_t rate;
-			vals >> rate;
-			// xserver wants the repeat-interval in ms,
-			// but xset r rate delay repeat rate,
-			// so interval = 1000Hz / rate
-			config->keyboard.interval = 1000.f / rate;
-		}
-		else if (key == "on_connect"sv) {
-			config->keyboard.on_connect = val;
-		}
-		else if (key == "on_disconnect"sv) {
-			config->keyboard.on_disconnect = val;
-		}
-		else {
-			throw std::logic_error{std::format("unknown keyboard section entry: {}", key)};
-		}
-		break;
-	case config_section::none:
-		std::cout << "not in a config section: "
-		          << key << " = " << val << std::endl;
-		exit(1);
-		break;
+void print_config(const xautocfg::config &cfg) {
+	std::cout << "keyboard config: "
+	          << "delay=" << cfg.keyboard.delay
+	          << ", interval=" << cfg.keyboard.interval
+	          << ", on_connect=" << cfg.keyboard.on_connect.hooks.size()
+	          << " hooks, on_disconnect=" << cfg.keyboard.on_disconnect.hooks.size()
+	          << " hooks, remaps=" << cfg.keyboard.remaps.size()
+	          << std::endl;
+	for (auto &rule : cfg.device_rules) {
+		std::cout << "device rule '" << rule.name << "': "
+		          << "match='" << rule.match_src
+		          << "', master='" << rule.master_src
+		          << "', delay=" << rule.keyboard.delay
+		          << ", interval=" << rule.keyboard.interval
+		          << ", remaps=" << rule.keyboard.remaps.size()
+		          << std::endl;
+	}
+	for (auto &profile : cfg.app_profiles) {
+		std::cout << "application profile '" << profile.name << "': "
+		          << "match='" << profile.match_src
+		          << "', delay=" << profile.delay
+		          << ", interval=" << profile.interval
+		          << std::endl;
 	}
 }
 
 
-config parse_config(const args &args) {
-	config ret{};
-
-	std::ifstream file{args.config, std::ios::binary};
-	if (not file.is_open()) {
-		std::cout << "failed to open config file '" << args.config << "'!" << std::endl;
-		if (args.custom_config) {
-			exit(1);
-		}
-		std::cout << "using default config." << std::endl;
-		return ret;
+/**
+ * uid of the user a local display belongs to, nullopt if it isn't local.
+ * that's who runs the X server, or, for a server running as root,
+ * who owns its socket (the display manager hands it to the session user).
+ */
+std::optional<uid_t> display_owner(const std::string &display) {
+	// [unix]:number[.screen], anything with a host name is remote
+	size_t colon = display.rfind(':');
+	if (colon == std::string::npos
+	    or (colon > 0 and display.compare(0, colon, "unix") != 0)) {
+		return std::nullopt;
 	}
-
-
-	const std::regex comment_re("^ *([^#]*) *#?.*");
-	const std::regex section_re("^\\[([^\\]]+)\\]$");
-	const std::regex kv_re("^([^= ]+) *= *(.+)$");
-	config_section current_section = config_section::none;
-
-	std::string fullline{};
-	int linenr = 0;
-	while (std::getline(file, fullline)) {
-		linenr += 1;
-		// filter comments
-		std::smatch comment_match;
-		std::regex_match(fullline, comment_match, comment_re);
-		if (not comment_match.ready() or comment_match.size() != 2) {
-			std::cout << "error in config file line " << linenr << ":\n"
-			          << fullline << std::endl;
-			exit(1);
+	std::string number = display.substr(colon + 1, display.find('.', colon) - colon - 1);
+	if (number.empty() or not std::ranges::all_of(number, [](char c) { return c >= '0' and c <= '9'; })) {
+		return std::nullopt;
+	}
+	std::string path = "/tmp/.X11-unix/X" + number;
+
+	std::optional<uid_t> ret;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd != -1) {
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		ucred cred;
+		socklen_t len = sizeof(cred);
+		if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0
+		    and getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0) {
+			ret = cred.uid;
 		}
+		close(fd);
+	}
 
-		const std::string& line{comment_match[1]};
-
-		// filter empty lines
-		if (line.size() == 0 or std::ranges::all_of(line, [](const char c) {
-			return c == ' ';
-		})) {
-			continue;
+	if (not ret or *ret == 0) {
+		struct stat st;
+		if (stat(path.c_str(), &st) == 0) {
+			ret = st.st_uid;
 		}
+	}
+	return ret;
+}
 
-		// parse '[section]'
-		{
-			std::smatch match;
-			std::regex_match(line, match, section_re);
-			if (match.ready() and match.size() == 2) {
-				const std::string& section_name{match[1]};
-				if (section_name == "keyboard") {
-					current_section = config_section::keyboard;
-				}
-				else {
-					std::cout << "unknown section name: " << fullline << std::endl;
-					exit(1);
-				}
-				continue;
-			}
-		}
 
-		// parse 'key = value'
-		{
-			std::smatch match;
-			std::regex_match(line, match, kv_re);
-			if (match.ready() and match.size() == 3) {
-				const std::string& key{match[1]};
-				const std::string& val{match[2]};
+/**
+ * the cookie file of the user's display, nullopt for xlib's default ~/.Xauthority.
+ * called as that user, so only files it can read are taken.
+ */
+std::optional<std::string> find_xauthority(const std::string &runtime_dir) {
+	// ours may be the one of the session already, e.g. when started by its display manager
+	const char *current = std::getenv("XAUTHORITY");
+	if (current and *current and access(current, R_OK) == 0) {
+		return current;
+	}
+	if (runtime_dir.empty()) {
+		return std::nullopt;
+	}
 
-				parse_config_entry(&ret, current_section, key, val);
-				continue;
-			}
+	// gdm, then xauth_* of sddm and lightdm
+	std::string gdm = runtime_dir + "/gdm/Xauthority";
+	if (access(gdm.c_str(), R_OK) == 0) {
+		return gdm;
+	}
+	std::error_code err;
+	for (auto &entry : std::filesystem::directory_iterator{runtime_dir, err}) {
+		std::string name = entry.path().filename();
+		if (name.starts_with("xauth_") and access(entry.path().c_str(), R_OK) == 0) {
+			return entry.path();
 		}
-
-		std::cout << "invalid syntax in line " << linenr << ":\n"
-		          << fullline << std::endl;
-		exit(1);
 	}
-
-	return ret;
+	return std::nullopt;
 }
 
 
-int exec_script(const std::string &command,
-                const std::unordered_map<std::string, std::string> &add_environment) {
-	pid_t pid = fork();
-
-	if (pid == -1) {
-		// failed to fork
-		std::cerr << "failed to fork for command " << command << std::endl;
+/**
+ * become that user, so its config, hooks and files are used as its own.
+ * the environment is the one of that user's login, not ours.
+ */
+bool drop_privileges(uid_t uid) {
+	passwd *pw = getpwuid(uid);
+	if (not pw) {
+		std::cout << "no user with id " << uid << std::endl;
+		return false;
+	}
+	if (initgroups(pw->pw_name, pw->pw_gid) != 0
+	    or setgid(pw->pw_gid) != 0
+	    or setuid(uid) != 0) {
+		perror("failed to switch user");
+		return false;
 	}
-	else if (pid == 0) {
-		// in child process
 
-		// add new environment entries
-		for (auto &&entry : add_environment) {
-			setenv(entry.first.c_str(), entry.second.c_str(), true);
-		}
+	setenv("HOME", pw->pw_dir, 1);
+	setenv("USER", pw->pw_name, 1);
+	setenv("LOGNAME", pw->pw_name, 1);
+	for (auto env : {"XDG_CONFIG_HOME", "XDG_CACHE_HOME", "XDG_STATE_HOME"}) {
+		unsetenv(env);
+	}
 
-		int ret = execlp("/bin/sh", "sh", "-c", command.c_str(), nullptr);
-		if (ret == -1) {
-			perror("failed to execute script");
-		}
+	// where logind puts the files of the user's sessions
+	std::string runtime_dir = std::format("/run/user/{}", uid);
+	if (access(runtime_dir.c_str(), X_OK) == 0) {
+		setenv("XDG_RUNTIME_DIR", runtime_dir.c_str(), 1);
 	}
 	else {
-		// in parent process
-		int status;
-		waitpid(pid, &status, 0);
+		runtime_dir.clear();
+		unsetenv("XDG_RUNTIME_DIR");
+	}
 
-		if (WIFEXITED(status)) {
-			return WEXITSTATUS(status);
-		}
-		else {
-			return -1;
-		}
+	// display managers keep the cookie there, otherwise xlib uses ~/.Xauthority
+	if (auto xauthority = find_xauthority(runtime_dir)) {
+		setenv("XAUTHORITY", xauthority->c_str(), 1);
+	}
+	else {
+		unsetenv("XAUTHORITY");
 	}
-	return -1;
+	return true;
 }
 
 
+struct served_display {
+	std::string name;
+	std::unique_ptr<xautocfg::instance> instance;
+};
+
+
 int main(int argc, char **argv) {
+	auto start_time = std::chrono::steady_clock::now();
 	args args = parse_args(argc, argv);
 
-	config cfg = parse_config(args);
-	std::cout << "keyboard config: "
-	          << "delay=" << cfg.keyboard.delay
-	          << ", interval=" << cfg.keyboard.interval
-	          << ", on_connect='" << cfg.keyboard.on_connect
-	          << "', on_disconnect='" << cfg.keyboard.on_disconnect
-	          << "'" << std::endl;
-
-	std::cout << "connecting to x..." << std::endl;
+	if (args.dump) {
+		// doesn't need the config
+		try {
+			xautocfg::dump_state(args.displays.empty() ? nullptr : args.displays[0].c_str(), std::cout);
+		}
+		catch (std::exception &err) {
+			std::cout << err.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
 
-	Display* display = XOpenDisplay(nullptr);
+	if (args.displays.empty()) {
+		const char *display = std::getenv("DISPLAY");
+		args.displays.emplace_back(display ? display : "");
+	}
 
-	int firstevent, error, opcode;
-	if (!XQueryExtension(display, "XInputExtension", &opcode, &firstevent, &error)) {
-		std::cout << "no xinput extension" << std::endl;
+	// status and reload requests are read in the event loop,
+	// child exits are those of the workers for other users.
+	// on termination the loop is left, so the instances put back what they changed.
+	sigset_t sigmask;
+	sigemptyset(&sigmask);
+	sigaddset(&sigmask, SIGUSR1);
+	sigaddset(&sigmask, SIGHUP);
+	sigaddset(&sigmask, SIGCHLD);
+	sigaddset(&sigmask, SIGTERM);
+	sigaddset(&sigmask, SIGINT);
+	sigprocmask(SIG_BLOCK, &sigmask, nullptr);
+	int sigfd = signalfd(-1, &sigmask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if (sigfd == -1) {
+		perror("failed to create signalfd");
 		return 1;
 	}
 
-	auto set_kbd_repeat_rate = [&](int deviceid, bool enabled) {
-		if (enabled) {
-			// we could use XkbUseCoreKbd as deviceid to always target the core
-			std::cout << "setting repeat rate on device=" << deviceid << std::endl;
-			XkbSetAutoRepeatRate(display, deviceid, cfg.keyboard.delay, cfg.keyboard.interval);
+	// as root, each user's displays are served by a worker running as that user,
+	// with that user's config. otherwise all displays get ours.
+	std::map<uid_t, std::vector<std::string>> owners;
+#ifndef XAUTOCFG_EMBEDDED_CONFIG
+	if (geteuid() == 0 and not args.custom_config) {
+		for (auto &display : args.displays) {
+			auto owner = display_owner(display);
+			if (not owner) {
+				std::cout << "can't find the owner of display '" << display
+				          << "', pass its config with --config" << std::endl;
+				return 1;
+			}
+			owners[*owner].push_back(display);
 		}
-	};
-
-	auto run_kbd_plug_script = [&](int deviceid, bool enabled) {
-		auto& command = enabled ? cfg.keyboard.on_connect : cfg.keyboard.on_disconnect;
+	}
+	else
+#endif
+	{
+		owners[geteuid()] = args.displays;
+	}
 
-		if (not command.empty()) {
-			auto script_ret = exec_script(
-				command,
-				{{"XINPUTID", std::format("{}", deviceid)}});
+	std::vector<std::string> displays;
+	std::map<pid_t, uid_t> workers;
+	for (auto &[uid, owned] : owners) {
+		if (uid == geteuid()) {
+			displays = owned;
+			continue;
+		}
 
-			if (script_ret != 0) {
-				std::cerr << "script failed: '" << command << "' exited with " << script_ret << std::endl;
+		pid_t pid = fork();
+		if (pid == -1) {
+			perror("failed to start worker");
+			return 1;
+		}
+		if (pid == 0) {
+			if (not drop_privileges(uid)) {
+				_exit(1);
 			}
+			// after switching the user, that resets it
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+			displays = owned;
+			workers.clear();
+			break;
 		}
-	};
-
-	auto handle_keyboard_plug = [&](int deviceid, bool enabled) {
-		set_kbd_repeat_rate(deviceid, enabled);
-		run_kbd_plug_script(deviceid, enabled);
-	};
+		std::cout << "serving displays of uid " << uid << " in worker " << pid << std::endl;
+		workers.emplace(pid, uid);
+	}
 
-	// set rate at startup for core keyboard
-	std::cout << "setting rate to core keyboard..." << std::endl;
-	set_kbd_repeat_rate(XkbUseCoreKbd, true);
+	// all our displays are of one user, so they share one config
+	std::shared_ptr<xautocfg::config_source> source;
+	[[maybe_unused]] xautocfg::config_cache configs;
+	if (not displays.empty()) {
+#ifdef XAUTOCFG_EMBEDDED_CONFIG
+		// checked at build time, nothing to read
+		source = std::make_shared<xautocfg::config_source>(xautocfg::embedded_config());
+#else
+		try {
+			if (args.custom_config) {
+				source = configs.get(geteuid(), {args.config}, true);
+			}
+			else {
+				source = configs.get(geteuid(), xautocfg::config_layers());
+			}
+		}
+		catch (std::exception &err) {
+			std::cout << err.what() << std::endl;
+			return 1;
+		}
+#endif
+		print_config(*source->current());
+	}
 
-	{
-		XIEventMask mask;
-		mask.deviceid = XIAllDevices;
-		mask.mask_len = XIMaskLen(XI_HierarchyChanged);
-		auto maskdata = std::make_unique<unsigned char[]>(mask.mask_len);
-		mask.mask = maskdata.get();
-		XISetMask(mask.mask, XI_HierarchyChanged);
-		XISelectEvents(display, DefaultRootWindow(display), &mask, 1);
+	std::vector<served_display> served;
+	for (auto &display : displays) {
+		try {
+			served.push_back({display, std::make_unique<xautocfg::instance>(
+				source, xautocfg::instance::options{
+					.display = display.empty() ? nullptr : display.c_str(),
+					.watch = not args.oneshot,
+					.log_x_errors = true,
+				}
+			)});
+		}
+		catch (std::exception &err) {
+			std::cout << "display '" << display << "': " << err.what() << std::endl;
+		}
+	}
+	if (served.empty() and workers.empty()) {
+		return 1;
 	}
 
-	XFlush(display);
+	if (args.oneshot) {
+		// the settings were sent without waiting, now wait until the server has processed them
+		for (auto &display : served) {
+			display.instance->sync();
+		}
+		int ret = served.size() == displays.size() ? 0 : 1;
+		for (auto &[pid, uid] : workers) {
+			int status;
+			if (waitpid(pid, &status, 0) == -1 or not WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+				ret = 1;
+			}
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start_time;
+		std::cout << "applied settings in "
+		          << std::chrono::duration<double, std::milli>(elapsed).count()
+		          << " ms" << std::endl;
+		return ret;
+	}
 
 	std::cout << "processing events..." << std::endl;
-	while (true) {
-		XEvent event;
-		XNextEvent(display, &event);
+	std::vector<pollfd> fds;
+	bool running = true;
+	while (running and (not served.empty() or not workers.empty())) {
+		fds.clear();
+		int timeout = -1;
+		for (auto &display : served) {
+			fds.push_back({display.instance->fd(), POLLIN, 0});
+			int next = display.instance->timeout();
+			if (next != -1 and (timeout == -1 or next < timeout)) {
+				timeout = next;
+			}
+		}
+		fds.push_back({sigfd, POLLIN, 0});
 
-		if (event.type == GenericEvent && event.xcookie.extension == opcode) {
-			if (event.xcookie.evtype == XI_HierarchyChanged) {
-				if (!XGetEventData(display, &event.xcookie))
-					continue;
+		if (poll(fds.data(), fds.size(), timeout) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("poll failed");
+			return 1;
+		}
 
-				XIHierarchyEvent *hev = reinterpret_cast<XIHierarchyEvent*>(event.xcookie.data);
-				if (!(hev->flags & (XIDeviceEnabled | XIDeviceDisabled)))
-					continue;
+		for (auto &display : served) {
+			display.instance->dispatch();
+		}
 
-				for (ssize_t i = 0; i < hev->num_info; i++) {
-					XIHierarchyInfo *hier = &hev->info[i];
-					if (hier->use == XISlaveKeyboard) {
-						if (hier->flags & XIDeviceEnabled) {
-							handle_keyboard_plug(hier->deviceid, true);
+		if (fds.back().revents) {
+			signalfd_siginfo info;
+			while (read(sigfd, &info, sizeof(info)) == sizeof(info)) {
+				if (info.ssi_signo == SIGCHLD) {
+					// also hooks, which are reaped by their instance
+					for (auto it = workers.begin(); it != workers.end();) {
+						int status;
+						if (waitpid(it->first, &status, WNOHANG) == it->first) {
+							std::cout << "worker for uid " << it->second << " exited" << std::endl;
+							it = workers.erase(it);
 						}
-						if (hier->flags & XIDeviceDisabled) {
-							handle_keyboard_plug(hier->deviceid, false);
+						else {
+							++it;
 						}
 					}
+					continue;
+				}
+
+				// the workers have their own displays and configs
+				for (auto &[pid, uid] : workers) {
+					kill(pid, info.ssi_signo);
+				}
+
+				if (info.ssi_signo == SIGTERM or info.ssi_signo == SIGINT) {
+					running = false;
+				}
+				else if (info.ssi_signo == SIGUSR1) {
+					for (auto &display : served) {
+						std::cout << "display '" << display.name << "':" << std::endl;
+						display.instance->print_status(std::cout);
+					}
+				}
+				else if (info.ssi_signo == SIGHUP and source) {
+#ifdef XAUTOCFG_EMBEDDED_CONFIG
+					std::cout << "the config is built into this binary, nothing to reload" << std::endl;
+#else
+					// only changed files are parsed again,
+					// a broken config keeps the current one running
+					if (configs.reload() > 0) {
+						std::cout << "reloaded config:" << std::endl;
+						print_config(*source->current());
+					}
+					else {
+						std::cout << "config files unchanged or invalid, not reloaded" << std::endl;
+					}
+#endif
 				}
 			}
 		}
 	}
 
-	XCloseDisplay(display);
+	// restores the gamma ramps of each display
+	std::cout << "exiting..." << std::endl;
+	served.clear();
+	for (auto &[pid, uid] : workers) {
+		waitpid(pid, nullptr, 0);
+	}
 	return 0;
 }